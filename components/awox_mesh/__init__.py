@@ -1,9 +1,11 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
+import esphome.final_validate as fv
 from esphome.components import esp32_ble_tracker, esp32_ble_client
 from esphome.components.esp32 import add_idf_sdkconfig_option
 
-from esphome.const import CONF_ID
+from esphome.const import CONF_ID, CONF_FRAMEWORK, CONF_INTERVAL, CONF_SDKCONFIG_OPTIONS
+from esphome.core import CORE
 
 AUTO_LOAD = ["esp32_ble_client", "esp32_ble_tracker"]
 DEPENDENCIES = ["mqtt", "esp32"]
@@ -28,7 +30,30 @@ CONF_MAX_CONNECTIONS = "max_connections"
 CONF_DEVICE_INFO = "device_info"
 CONF_ALLOWED_MESH_IDS = "allowed_mesh_ids"
 CONF_ALLOWED_ADDRESSES = "allowed_mac_addresses"
-MAX_CONNECTIONS = 3
+CONF_STATE_PUBLISH_INTERVAL = "state_publish_interval"
+CONF_BULK_STATE_INTERVAL = "bulk_state_interval"
+CONF_BINARY_PROTOCOL = "binary_protocol"
+CONF_DISCOVERY_MESSAGES_PER_SECOND = "discovery_messages_per_second"
+CONF_DISCOVERY_BYTES_PER_SECOND = "discovery_bytes_per_second"
+CONF_DISCOVERY_ABBREVIATIONS = "discovery_abbreviations"
+CONF_TOPOLOGY_CACHE = "topology_cache"
+CONF_MAX_CONCURRENT_CONNECTS = "max_concurrent_connects"
+CONF_COMMAND_MAX_AGE = "command_max_age"
+CONF_ONLINE_DEBOUNCE = "online_debounce"
+CONF_OFFLINE_DEBOUNCE = "offline_debounce"
+CONF_LIVENESS_PROBES_PER_SECOND = "liveness_probes_per_second"
+CONF_LIVENESS_TIMEOUT = "liveness_timeout"
+CONF_LIVENESS_MAX_PROBES = "liveness_max_probes"
+CONF_PARTITION = "partition"
+CONF_HEARTBEAT_INTERVAL = "heartbeat_interval"
+CONF_STANDBY_FOR = "standby_for"
+CONF_ADAPTIVE_SCAN = "adaptive_scan"
+CONF_ESP32_BLE_TRACKER = "esp32_ble_tracker"
+CONF_SCAN_PARAMETERS = "scan_parameters"
+CONF_WINDOW = "window"
+CONF_BT_ACL_CONNECTIONS = "CONFIG_BT_ACL_CONNECTIONS"
+# Bluedroid supports up to 9 ACL connections
+MAX_CONNECTIONS = 9
 
 DEVICE_TYPES = {
     "RGB": 0x01,
@@ -49,6 +74,12 @@ def validate_connections(config):
     return conf
 
 
+def validate_standby(config):
+    if CONF_STANDBY_FOR in config and CONF_HEARTBEAT_INTERVAL not in config:
+        raise cv.Invalid(f"'{CONF_STANDBY_FOR}' requires the '{CONF_HEARTBEAT_INTERVAL}' of the primary hub")
+    return config
+
+
 CONFIG_SCHEMA = cv.All(
     cv.Schema(
         {
@@ -63,9 +94,36 @@ CONFIG_SCHEMA = cv.All(
             ),
             cv.Optional(CONF_ADDRESS_PREFIX): cv.string_strict,
             cv.Optional(CONF_MAX_CONNECTIONS, default=2): cv.int_range(min=1, max=MAX_CONNECTIONS),
+            cv.Optional(CONF_MAX_CONCURRENT_CONNECTS, default=2): cv.int_range(min=1, max=MAX_CONNECTIONS),
             cv.Optional(CONF_MIN_RSSI): cv.int_range(min=-100, max=-10),
             cv.Optional(CONF_ALLOWED_MESH_IDS, default=[]): cv.ensure_list(cv.int_),
             cv.Optional(CONF_ALLOWED_ADDRESSES, default=[]): cv.ensure_list(cv.mac_address),
+            cv.Optional(CONF_STATE_PUBLISH_INTERVAL, default="500ms"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_COMMAND_MAX_AGE, default="10s"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_ONLINE_DEBOUNCE, default="3s"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_OFFLINE_DEBOUNCE, default="3s"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_LIVENESS_PROBES_PER_SECOND, default=0.5): cv.float_range(min=0, max=10),
+            cv.Optional(CONF_LIVENESS_TIMEOUT, default="5min"): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(min=cv.TimePeriod(seconds=30)),
+            ),
+            cv.Optional(CONF_LIVENESS_MAX_PROBES, default=3): cv.int_range(min=1, max=10),
+            cv.Optional(CONF_BINARY_PROTOCOL, default=False): cv.boolean,
+            cv.Optional(CONF_DISCOVERY_MESSAGES_PER_SECOND, default=5): cv.int_range(min=0, max=100),
+            cv.Optional(CONF_DISCOVERY_BYTES_PER_SECOND, default=4096): cv.int_range(min=0),
+            cv.Optional(CONF_DISCOVERY_ABBREVIATIONS, default=False): cv.boolean,
+            cv.Optional(CONF_TOPOLOGY_CACHE, default=True): cv.boolean,
+            cv.Optional(CONF_PARTITION, default=False): cv.boolean,
+            cv.Optional(CONF_HEARTBEAT_INTERVAL): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(min=cv.TimePeriod(milliseconds=500)),
+            ),
+            cv.Optional(CONF_STANDBY_FOR): cv.string_strict,
+            cv.Optional(CONF_ADAPTIVE_SCAN, default=True): cv.boolean,
+            cv.Optional(CONF_BULK_STATE_INTERVAL): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(min=cv.TimePeriod(seconds=1)),
+            ),
             cv.Optional(CONF_DEVICE_INFO, default=[]): cv.ensure_list(
                 cv.Schema(
                     {
@@ -83,9 +141,38 @@ CONFIG_SCHEMA = cv.All(
     .extend(esp32_ble_tracker.ESP_BLE_DEVICE_SCHEMA)
     .extend(cv.COMPONENT_SCHEMA),
     validate_connections,
+    validate_standby,
 )
 
 
+def configured_acl_connections(full_config):
+    """Number of BLE connections Bluedroid is configured for, None when left to the default"""
+    tracker_config = full_config.get(CONF_ESP32_BLE_TRACKER) or {}
+    if CONF_MAX_CONNECTIONS in tracker_config:
+        return tracker_config[CONF_MAX_CONNECTIONS]
+
+    framework_config = (full_config.get("esp32") or {}).get(CONF_FRAMEWORK, {})
+    sdkconfig_options = framework_config.get(CONF_SDKCONFIG_OPTIONS, {})
+    if CONF_BT_ACL_CONNECTIONS in sdkconfig_options:
+        return int(sdkconfig_options[CONF_BT_ACL_CONNECTIONS])
+
+    return None
+
+
+def validate_acl_connections(config):
+    acl_connections = configured_acl_connections(fv.full_config.get())
+    if acl_connections is not None and config[CONF_MAX_CONNECTIONS] > acl_connections:
+        raise cv.Invalid(
+            f"{CONF_MAX_CONNECTIONS} of {config[CONF_MAX_CONNECTIONS]} exceeds the {acl_connections} BLE connections "
+            f"Bluedroid is configured for, raise '{CONF_MAX_CONNECTIONS}' of '{CONF_ESP32_BLE_TRACKER}' "
+            f"(or {CONF_BT_ACL_CONNECTIONS})"
+        )
+    return config
+
+
+FINAL_VALIDATE_SCHEMA = validate_acl_connections
+
+
 async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
@@ -120,6 +207,62 @@ async def to_code(config):
     if config.get(CONF_MIN_RSSI):
         cg.add(var.set_min_rssi(config[CONF_MIN_RSSI]))
 
+    cg.add(var.set_state_publish_interval(config[CONF_STATE_PUBLISH_INTERVAL]))
+
+    cg.add(var.set_binary_protocol(config[CONF_BINARY_PROTOCOL]))
+
+    cg.add(
+        var.set_discovery_rate(
+            config[CONF_DISCOVERY_MESSAGES_PER_SECOND],
+            config[CONF_DISCOVERY_BYTES_PER_SECOND],
+        )
+    )
+
+    cg.add(var.set_discovery_abbreviations(config[CONF_DISCOVERY_ABBREVIATIONS]))
+
+    cg.add(var.set_topology_cache(config[CONF_TOPOLOGY_CACHE]))
+
+    cg.add(var.set_max_concurrent_connects(config[CONF_MAX_CONCURRENT_CONNECTS]))
+
+    cg.add(var.set_command_max_age(config[CONF_COMMAND_MAX_AGE]))
+
+    cg.add(var.set_availability_debounce(config[CONF_ONLINE_DEBOUNCE], config[CONF_OFFLINE_DEBOUNCE]))
+
+    cg.add(
+        var.set_liveness_probing(
+            config[CONF_LIVENESS_PROBES_PER_SECOND],
+            config[CONF_LIVENESS_TIMEOUT],
+            config[CONF_LIVENESS_MAX_PROBES],
+        )
+    )
+
+    scan_parameters = (CORE.config.get(CONF_ESP32_BLE_TRACKER) or {}).get(CONF_SCAN_PARAMETERS)
+    if config[CONF_ADAPTIVE_SCAN] and scan_parameters:
+        # Scan interval and window in 0.625 ms units, like the esp32_ble_tracker
+        cg.add(
+            var.set_adaptive_scan(
+                int(scan_parameters[CONF_INTERVAL].total_milliseconds / 0.625),
+                int(scan_parameters[CONF_WINDOW].total_milliseconds / 0.625),
+            )
+        )
+
+    if CONF_HEARTBEAT_INTERVAL in config:
+        cg.add(var.set_heartbeat_interval(config[CONF_HEARTBEAT_INTERVAL]))
+
+    if CONF_STANDBY_FOR in config:
+        cg.add(var.set_standby_for(config[CONF_STANDBY_FOR]))
+
+    if config[CONF_PARTITION]:
+        cg.add(var.set_partition_topic(f"awox_mesh/{config[CONF_MESH_NAME]}/partition"))
+
+    if CONF_BULK_STATE_INTERVAL in config:
+        cg.add(var.set_bulk_state_interval(config[CONF_BULK_STATE_INTERVAL]))
+
+    # Make sure Bluedroid and the controller accept all connections
+    acl_connections = configured_acl_connections(CORE.config) or config[CONF_MAX_CONNECTIONS]
+    add_idf_sdkconfig_option(CONF_BT_ACL_CONNECTIONS, acl_connections)
+    add_idf_sdkconfig_option("CONFIG_BTDM_CTRL_BLE_MAX_CONN", acl_connections)
+
     for connection_conf in config.get(CONF_CONNECTIONS, []):
         connection_var = cg.new_Pvariable(connection_conf[CONF_ID])
         await cg.register_component(connection_var, connection_conf)
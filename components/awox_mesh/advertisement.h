@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace awox_mesh {
+
+/** Manufacturer data of a Telink mesh advertisement, without the 2 byte company id */
+#define ADVERTISEMENT_MIN_SIZE 11
+#define ADVERTISEMENT_MAC_OFFSET 2
+#define ADVERTISEMENT_PRODUCT_UUID_OFFSET 6
+#define ADVERTISEMENT_MESH_ID_OFFSET 9
+
+struct AdvertisementInfo {
+  int mesh_id = 0;
+  /** 16 bit product uuid as advertised */
+  int product_uuid = 0;
+  /** Product id of the `device_info` config, like the product code of a MAC report */
+  int product_id = 0;
+};
+
+/**
+ * Decode the mesh id and product id from the manufacturer data of a Telink/AwoX mesh advertisement.
+ *
+ * Layout of the Telink advertisement: bytes 0-1 mesh product uuid, bytes 2-5 the last 4 bytes of the mac address in
+ * reverse order (used to recognize the format), bytes 6-7 the product uuid, byte 8 the status and bytes 9-10 the
+ * mesh id. All values are little endian. AwoX keeps the product id in the high byte of the product uuid.
+ *
+ * @param mac 6 byte mac address of the advertising device, most significant byte first
+ */
+static bool decode_advertisement(const uint8_t *mac, const std::vector<uint8_t> &data, AdvertisementInfo &info) {
+  if (data.size() < ADVERTISEMENT_MIN_SIZE) {
+    return false;
+  }
+
+  for (int i = 0; i < 4; i++) {
+    if (data[ADVERTISEMENT_MAC_OFFSET + i] != mac[5 - i]) {
+      return false;
+    }
+  }
+
+  const int mesh_id = data[ADVERTISEMENT_MESH_ID_OFFSET] | (data[ADVERTISEMENT_MESH_ID_OFFSET + 1] << 8);
+  if (mesh_id == 0) {
+    return false;
+  }
+
+  info.mesh_id = mesh_id;
+  info.product_uuid = data[ADVERTISEMENT_PRODUCT_UUID_OFFSET] | (data[ADVERTISEMENT_PRODUCT_UUID_OFFSET + 1] << 8);
+  info.product_id = info.product_uuid >> 8;
+  return true;
+}
+
+}  // namespace awox_mesh
+}  // namespace esphome
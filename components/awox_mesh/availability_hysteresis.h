@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace awox_mesh {
+
+enum AvailabilityObservation : uint8_t {
+  /** Availability is the published one (again), nothing to publish */
+  AVAILABILITY_PUBLISHED = 0,
+  /** Availability is pending already, its deadline didn't move */
+  AVAILABILITY_PENDING,
+  /** Availability is pending with a new deadline, schedule it */
+  AVAILABILITY_SCHEDULED,
+};
+
+struct AvailabilityHysteresis {
+  /** Availability waiting for its debounce time to pass */
+  bool pending = false;
+  bool has_pending = false;
+  uint32_t deadline = 0;
+  /** Number of times the availability returned to the published value before the debounce time passed */
+  uint16_t flaps = 0;
+};
+
+/**
+ * Debounced availability of all mesh devices, indexed by `Device::index`.
+ *
+ * Each device holds a single pending value, a device flapping at the edge of the mesh only moves the deadline of
+ * that value instead of queueing every change. Going online and going offline have their own debounce time.
+ * The published availability is not kept here, discovery and republish publish it too.
+ *
+ * The table has no timer of its own, the caller schedules every new deadline and hands it back with `expire()`.
+ * A deadline of a value that was dropped or replaced meanwhile doesn't match anymore and is ignored.
+ */
+class AvailabilityTable {
+  std::vector<AvailabilityHysteresis> entries_{};
+  uint32_t online_debounce_ms_ = 3000;
+  uint32_t offline_debounce_ms_ = 3000;
+  uint32_t flaps_ = 0;
+
+  AvailabilityHysteresis &entry_(size_t index) {
+    if (index >= this->entries_.size()) {
+      this->entries_.resize(index + 1);
+    }
+    return this->entries_[index];
+  }
+
+ public:
+  void set_online_debounce(uint32_t debounce) { this->online_debounce_ms_ = debounce; }
+
+  void set_offline_debounce(uint32_t debounce) { this->offline_debounce_ms_ = debounce; }
+
+  /**
+   * Record the current availability of a device, AVAILABILITY_SCHEDULED asks to schedule `get_deadline(index)`.
+   *
+   * @param published `online` is the availability last published for the device
+   */
+  AvailabilityObservation observe(size_t index, bool online, bool published, uint32_t now) {
+    AvailabilityHysteresis &entry = this->entry_(index);
+
+    if (entry.has_pending && entry.pending == online) {
+      return AVAILABILITY_PENDING;
+    }
+
+    if (published) {
+      if (entry.has_pending) {
+        entry.has_pending = false;
+        if (entry.flaps < UINT16_MAX) {
+          entry.flaps++;
+        }
+        this->flaps_++;
+      }
+      return AVAILABILITY_PUBLISHED;
+    }
+
+    entry.pending = online;
+    entry.has_pending = true;
+    entry.deadline = now + (online ? this->online_debounce_ms_ : this->offline_debounce_ms_);
+    return AVAILABILITY_SCHEDULED;
+  }
+
+  uint32_t get_deadline(size_t index) const {
+    return index < this->entries_.size() ? this->entries_[index].deadline : 0;
+  }
+
+  /** Drop the pending availability when `deadline` is still its deadline, returns true when it is to be published */
+  bool expire(size_t index, uint32_t deadline) {
+    if (index >= this->entries_.size()) {
+      return false;
+    }
+
+    AvailabilityHysteresis &entry = this->entries_[index];
+    if (!entry.has_pending || entry.deadline != deadline) {
+      return false;
+    }
+    entry.has_pending = false;
+    return true;
+  }
+
+  /** Drop all pending availability, without counting it as flaps */
+  void cancel_pending() {
+    for (auto &entry : this->entries_) {
+      entry.has_pending = false;
+    }
+  }
+
+  uint16_t get_flaps(size_t index) const { return index < this->entries_.size() ? this->entries_[index].flaps : 0; }
+
+  /** Flaps of all devices together */
+  uint32_t get_flaps() const { return this->flaps_; }
+};
+
+}  // namespace awox_mesh
+}  // namespace esphome
@@ -5,7 +5,11 @@
 #include <math.h>
 #include <regex>
 #include "awox_mesh.h"
+#include "advertisement.h"
+#include "esp_heap_caps.h"
 
+#include "esphome/core/application.h"
+#include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
 
 namespace esphome {
@@ -28,6 +32,21 @@ static bool matching_mesh_ids(const std::vector<int> &vector1, const std::vector
   return result.size() > 0;
 }
 
+/** Number of mesh ids in sorted vector1 that are not in sorted vector2 */
+static int count_missing_mesh_ids(const std::vector<int> &vector1, const std::vector<int> &vector2) {
+  int missing = 0;
+  std::vector<int>::const_iterator position = vector2.begin();
+
+  for (int mesh_id : vector1) {
+    position = std::lower_bound(position, vector2.end(), mesh_id);
+    if (position == vector2.end() || *position != mesh_id) {
+      missing++;
+    }
+  }
+
+  return missing;
+}
+
 float AwoxMesh::get_setup_priority() const { return setup_priority::AFTER_CONNECTION; }
 
 void AwoxMesh::register_connection(MeshConnection *connection) {
@@ -38,6 +57,7 @@ void AwoxMesh::register_connection(MeshConnection *connection) {
   connection->mesh_name = this->mesh_name;
   connection->mesh_password = this->mesh_password;
   connection->mesh_ = this;
+  connection->command_max_age = this->command_max_age_ms;
 
   connection->set_disconnect_callback([this]() {
     ESP_LOGI(TAG, "disconnected");
@@ -63,10 +83,13 @@ FoundDevice *AwoxMesh::add_to_found_devices(const esp32_ble_tracker::ESPBTDevice
     this->found_devices_.push_back(found_device);
   }
 
-  found_device->rssi = device.get_rssi();
+  // Rank on the smoothed RSSI instead of the last advertisement
+  found_device->rssi_estimator.add(device.get_rssi());
+  found_device->rssi = found_device->rssi_estimator.confident_rssi();
   found_device->last_detected = esphome::millis();
-
-  this->set_rssi_for_devices_that_are_not_available();
+  if (found_device->sightings < UINT16_MAX) {
+    found_device->sightings++;
+  }
 
   this->sort_devices();
 
@@ -86,10 +109,32 @@ bool AwoxMesh::parse_device(const esp32_ble_tracker::ESPBTDevice &device) {
     return false;
   }
 
-  add_to_found_devices(device);
+  AdvertisementInfo advertisement{};
+  bool decoded = false;
+  for (auto &manufacturer_data : device.get_manufacturer_datas()) {
+    if (decode_advertisement(device.address(), manufacturer_data.data, advertisement)) {
+      decoded = true;
+      break;
+    }
+  }
+
+  // Skip devices outside the allowed mesh ids before wasting a connection on them
+  if (decoded && !this->mesh_id_allowed(advertisement.mesh_id)) {
+    ESP_LOGV(TAG, "Skipped device %s - %s [%u]. RSSI: %d, not in allowed_mesh_ids", device.get_name().c_str(),
+             device.address_str().c_str(), advertisement.mesh_id, (int) device.get_rssi());
+    return false;
+  }
+
+  FoundDevice *found_device = add_to_found_devices(device);
 
-  ESP_LOGV(TAG, "Found Awox device %s - %s. RSSI: %d dB (total devices: %d)", device.get_name().c_str(),
-           device.address_str().c_str(), (int) device.get_rssi(), this->found_devices_.size());
+  if (decoded && found_device->mesh_id != advertisement.mesh_id) {
+    ESP_LOGD(TAG, "Advertisement of %s: mesh_id %u, productID: 0x%02X", device.address_str().c_str(),
+             advertisement.mesh_id, advertisement.product_id);
+    found_device->mesh_id = advertisement.mesh_id;
+  }
+
+  ESP_LOGV(TAG, "Found Awox device %s - %s [%u]. RSSI: %d dB (total devices: %d)", device.get_name().c_str(),
+           device.address_str().c_str(), found_device->mesh_id, (int) device.get_rssi(), this->found_devices_.size());
 
   return true;
 }
@@ -99,103 +144,250 @@ void AwoxMesh::setup() {
 
   this->publish_connection->setup();
 
+  if (this->topology_cache_) {
+    this->restore_topology();
+  }
+
   this->publish_connection->publish_connection_sensor_discovery(this->connections_);
 
   this->set_interval("publish_connection", 5000, [this]() { this->publish_connected(); });
+
+  this->set_interval("publish_statistics", 30000, [this]() { this->publish_statistics(); });
+
+  this->set_interval("overlapping_connections", 5000, [this]() {
+    if (this->ready_to_connect && this->active()) {
+      this->disconnect_connections_with_overlapping_mesh_ids();
+    }
+  });
+
+  this->deadlines_.push(esphome::millis() + this->found_device_cleanup_interval_ms, DEADLINE_RSSI_CLEANUP);
+
+  if (this->liveness_probe_interval_ms > 0) {
+    this->deadlines_.push(esphome::millis() + this->liveness_timeout_ms, DEADLINE_LIVENESS_PROBE);
+  }
+
+  if (this->heartbeat_interval_ms > 0) {
+    this->set_interval("heartbeat", this->heartbeat_interval_ms, [this]() {
+      if (this->active()) {
+        this->publish_connection->publish_heartbeat(this->online_devices_);
+      }
+    });
+  }
+
+  if (this->partitioning_) {
+    this->partition_.set_hub_id(App.get_name());
+    this->partition_.set_expire_time(this->partition_announce_interval_ms * 3);
+    this->set_interval("partition", 5000, [this]() { this->update_partition(); });
+  }
+
+  if (this->publish_connection->get_bulk_state_interval() > 0) {
+    this->set_interval("publish_bulk_state", this->publish_connection->get_bulk_state_interval(),
+                       [this]() { this->publish_connection->publish_bulk_state(); });
+  }
 }
 
 bool AwoxMesh::start_up_delay_done() {
-  return esphome::millis() - this->start > 10000 && this->found_devices_.size() > 0;
+  if (this->found_devices_.empty()) {
+    return false;
+  }
+
+  if (esphome::millis() - this->start > this->start_up_max_delay_ms) {
+    ESP_LOGI(TAG, "Start connecting, no preferred device found within %u ms", this->start_up_max_delay_ms);
+    return true;
+  }
+
+  for (auto *found_device : this->found_devices_) {
+    if (found_device->rssi < this->minimum_rssi) {
+      continue;
+    }
+
+    if (found_device->sightings >= this->start_up_min_sightings) {
+      ESP_LOGI(TAG, "Start connecting, %s seen %u times", found_device->device.address_str().c_str(),
+               found_device->sightings);
+      return true;
+    }
+
+    // Device known from the topology cache to reach other mesh devices
+    Device *device = this->get_device(found_device->device.address_uint64());
+    if (device != nullptr && device->known_reach > 0) {
+      ESP_LOGI(TAG, "Start connecting, cached device %s [%u] found", found_device->device.address_str().c_str(),
+               device->mesh_id);
+      return true;
+    }
+  }
+
+  return false;
 }
 
 void AwoxMesh::loop() {
+  this->flush_pending_state_publish();
+
+  this->publish_connection->loop();
+
   if (!ready_to_connect && this->start_up_delay_done()) {
     ready_to_connect = true;
+    this->statistics_.boot_to_first_attempt_ms = esphome::millis() - this->start;
+  }
+
+  if (!this->standby_for_.empty()) {
+    this->check_primary();
   }
 
-  if (!ready_to_connect) {
+  this->process_deadlines();
+
+  if (!ready_to_connect || !this->active()) {
     return;
   }
 
+  this->manage_handover();
+
   const uint32_t now = esphome::millis();
-  const uint32_t since_last_attempt = now - this->last_connection_attempt;
+  if (this->last_empty_candidate_search != 0 &&
+      now - this->last_empty_candidate_search < this->candidate_search_interval_ms) {
+    return;
+  }
+
+  // Fill idle slots on every pass, the backoff in connect_allowed() paces the attempts per device
+  int establishing = 0;
+  for (auto *connection : this->connections_) {
+    if (connection->establishing()) {
+      establishing++;
+    }
+  }
 
-  if ((!this->has_active_connection && since_last_attempt > 5000) || since_last_attempt > 20000) {
-    this->last_connection_attempt = now;
+  for (auto *connection : this->connections_) {
+    if (establishing >= this->max_concurrent_connects) {
+      break;
+    }
+    if (connection->get_slot_state() != SLOT_IDLE) {
+      continue;
+    }
 
-    this->disconnect_connections_with_overlapping_mesh_ids();
+    auto *found_device = this->next_to_connect();
 
-    for (auto *connection : this->connections_) {
-      if (connection->get_address() == 0) {
-        auto *found_device = this->next_to_connect();
+    if (found_device == nullptr) {
+      ESP_LOGD(TAG, "No devices found to connect to");
+      this->last_empty_candidate_search = now;
+      break;
+    }
+    this->last_empty_candidate_search = 0;
+
+    ESP_LOGI(TAG, "Try to connect %s => rssi: %d", found_device->device.address_str().c_str(),
+             (int) found_device->rssi);
+
+    connection->connect_to(found_device);
+    establishing++;
+  }
+}
+
+void AwoxMesh::process_deadlines() {
+  const uint32_t now = esphome::millis();
 
-        if (found_device == nullptr) {
-          ESP_LOGD(TAG, "No devices found to connect to");
-          break;
+  while (this->deadlines_.expired(now)) {
+    Deadline deadline = this->deadlines_.pop();
+
+    switch (deadline.type) {
+      case DEADLINE_DEVICE_INFO_RETRY: {
+        Device *device = static_cast<Device *>(deadline.target);
+        // Skip deadlines of earlier requests, every request schedules its own retry until discovery is send
+        if (!device->send_discovery && now - device->device_info_requested >= this->device_info_request_interval_ms) {
+          ESP_LOGD(TAG, "Request info again for %u", device->mesh_id);
+          this->request_device_info(device);
         }
+        break;
+      }
 
-        if (found_device->connected) {
-          ESP_LOGI(TAG, "Skipped to connect %s => rssi: %d already connected!!",
-                   found_device->device.address_str().c_str(), (int) found_device->rssi);
-          break;
+      case DEADLINE_GROUP_DISCOVERY: {
+        Group *group = static_cast<Group *>(deadline.target);
+        if (!group->send_discovery && group->device_info != nullptr) {
+          this->send_group_discovery(group);
         }
+        break;
+      }
 
-        ESP_LOGI(TAG, "Try to connect %s => rssi: %d", found_device->device.address_str().c_str(),
-                 (int) found_device->rssi);
+      case DEADLINE_RSSI_CLEANUP:
+        this->set_rssi_for_devices_that_are_not_available();
+        this->deadlines_.push(now + this->found_device_cleanup_interval_ms, DEADLINE_RSSI_CLEANUP);
+        break;
 
-        connection->connect_to(found_device);
+      case DEADLINE_LIVENESS_PROBE:
+        this->probe_liveness(now);
+        this->deadlines_.push(now + this->liveness_probe_interval_ms, DEADLINE_LIVENESS_PROBE);
+        break;
 
-        // max 1 new connection per loop()
+      case DEADLINE_AVAILABILITY_PUBLISH: {
+        Device *device = static_cast<Device *>(deadline.target);
+        // Skip deadlines of availability that returned to the published value or moved meanwhile
+        if (this->availability_.expire(device->index, deadline.at)) {
+          this->publish_availability(device, false);
+        }
         break;
       }
     }
   }
+}
 
-  for (auto *device : this->mesh_devices_) {
-    if (!device->send_discovery && device->device_info_requested > 0 &&
-        device->device_info_requested < esphome::millis() - this->device_info_request_interval_ms) {
-      ESP_LOGD(TAG, "Request info again for %u", device->mesh_id);
-      this->request_device_info(device);
-    }
+void AwoxMesh::probe_liveness(uint32_t now) {
+  if (!this->active() || !this->has_active_connection) {
+    return;
   }
 
-  while (!this->delayed_availability_publish.empty()) {
-    if (this->delayed_availability_publish.front().time > esphome::millis() - this->delayed_availability_publish_debounce_time_ms) {
-      break;
+  // One probe per call keeps the probes within the packets per second budget
+  Device *silent = nullptr;
+  for (Device *device : this->mesh_devices_) {
+    if (!device->online || now - device->last_online < this->liveness_timeout_ms ||
+        !this->mesh_id_owned(device->mesh_id)) {
+      continue;
+    }
+    if (device->liveness_probes > 0 && now - device->last_liveness_probe < this->liveness_probe_timeout_ms) {
+      continue;
     }
 
-    PublishOnlineStatus publish = this->delayed_availability_publish.front();
-    this->delayed_availability_publish.pop_front();
-    if (publish.online == publish.device->online) {
-      this->publish_availability(publish.device, false);
-    } else {
-      ESP_LOGD(TAG, "Skipped publishing availability for %u - %s (is currently %s again)", publish.device->mesh_id,
-               publish.online ? "Online" : "Offline", publish.device->online ? "Online" : "Offline");
+    if (device->liveness_probes >= this->liveness_max_probes) {
+      ESP_LOGW(TAG, "%u did not answer %u liveness probes, silent for %u ms, mark offline", device->mesh_id,
+               device->liveness_probes, now - device->last_online);
+      device->online = false;
+      device->liveness_probes = 0;
+      for (auto *connection : this->connections_) {
+        connection->remove_mesh_id(device->mesh_id);
+      }
+      this->statistics_.liveness_offline++;
+      this->publish_availability(device, true);
+      continue;
     }
-  }
 
-  for (Group *group : this->mesh_groups_) {
-    if (!group->send_discovery && group->device_info != nullptr) {
-      this->send_group_discovery(group);
+    if (silent == nullptr || (int32_t) (silent->last_online - device->last_online) > 0) {
+      silent = device;
     }
   }
 
-  if (now - this->last_found_device_cleanup < 20000) {
-    this->set_rssi_for_devices_that_are_not_available();
+  if (silent == nullptr) {
+    return;
   }
+
+  ESP_LOGD(TAG, "Liveness probe %u for %u, silent for %u ms", silent->liveness_probes + 1, silent->mesh_id,
+           now - silent->last_online);
+  silent->liveness_probes++;
+  silent->last_liveness_probe = now;
+  this->statistics_.liveness_probes++;
+  const int dest = silent->mesh_id;
+  this->call_connection(dest, [dest](MeshConnection *connection) { connection->send_liveness_probe(dest); });
 }
 
 void AwoxMesh::disconnect_connections_with_overlapping_mesh_ids() {
   const int connections_count = this->connections_.size();
   for (int i = 0; i < connections_count; i++) {
-    if (this->connections_[i]->get_address() == 0) {
-      continue;
-    }
-    if (i - 1 >= 0 && this->connections_[i - 1]->connected()) {
-      this->disconnect_connection_with_overlapping_mesh_ids(i - 1, i);
-    }
-    if (i + 1 < connections_count && this->connections_[i + 1]->connected()) {
-      this->disconnect_connection_with_overlapping_mesh_ids(i + 1, i);
+    for (int j = i + 1; j < connections_count; j++) {
+      if (this->connections_[i]->get_address() == 0 || this->connections_[j]->get_address() == 0) {
+        continue;
+      }
+      // Both connections are expected to overlap until the handover is done
+      if (this->in_handover(i) && this->in_handover(j)) {
+        continue;
+      }
+      if (this->connections_[i]->connected() || this->connections_[j]->connected()) {
+        this->disconnect_connection_with_overlapping_mesh_ids(i, j);
+      }
     }
   }
 }
@@ -235,8 +427,10 @@ FoundDevice *AwoxMesh::next_to_connect() {
 
   ESP_LOGD(TAG, "Total devices: %d", this->found_devices_.size());
   for (auto *found_device : this->found_devices_) {
-    ESP_LOGD(TAG, "Available device %s [%u] => rssi: %d", found_device->device.address_str().c_str(),
-             found_device->mesh_id, (int) found_device->rssi);
+    ESP_LOGD(TAG, "Available device %s [%u] => rssi: %d (mean: %.1f, stddev: %.1f, samples: %u)",
+             found_device->device.address_str().c_str(), found_device->mesh_id, (int) found_device->rssi,
+             found_device->rssi_estimator.mean(), found_device->rssi_estimator.stddev(),
+             found_device->rssi_estimator.samples());
   }
 
   std::vector<int> linked_mesh_ids;
@@ -244,11 +438,19 @@ FoundDevice *AwoxMesh::next_to_connect() {
     if (connection->connected()) {
       copy(connection->get_linked_mesh_ids().begin(), connection->get_linked_mesh_ids().end(),
            std::back_inserter(linked_mesh_ids));
+    } else if (connection->establishing() && connection->found_device != nullptr) {
+      // Expected reach of connections that are being established
+      copy(connection->found_device->reachable_mesh_ids.begin(), connection->found_device->reachable_mesh_ids.end(),
+           std::back_inserter(linked_mesh_ids));
+      if (connection->found_device->mesh_id) {
+        linked_mesh_ids.push_back(connection->found_device->mesh_id);
+      }
     }
   }
   sort(linked_mesh_ids.begin(), linked_mesh_ids.end());
   linked_mesh_ids.erase(unique(linked_mesh_ids.begin(), linked_mesh_ids.end()), linked_mesh_ids.end());
 
+  const uint32_t now = esphome::millis();
   int known_mesh_devices = 0;
   int identified_mesh_devices = 0;
   for (auto *mesh_device : this->mesh_devices_) {
@@ -263,33 +465,386 @@ FoundDevice *AwoxMesh::next_to_connect() {
       "Currently %d mesh devices reachable through active connections (%d currently known and %d fully recognized)",
       linked_mesh_ids.size(), known_mesh_devices, identified_mesh_devices);
 
+  // Greedy set cover: pick the device that adds the most not yet reachable mesh ids, based on what the device
+  // reached in earlier connections. Devices are sorted by RSSI so on a tie the strongest signal wins.
+  FoundDevice *best = nullptr;
+  int best_gain = 0;
   for (auto *found_device : this->found_devices_) {
-    if (!found_device->connected && found_device->rssi >= this->minimum_rssi) {
+    if (found_device->connected || found_device->rssi < this->minimum_rssi ||
+        !this->connect_allowed(found_device, now)) {
+      continue;
+    }
+
+    int gain = 0;
+    if (!found_device->reachable_mesh_ids.empty()) {
+      gain = count_missing_mesh_ids(found_device->reachable_mesh_ids, linked_mesh_ids);
+    } else if (found_device->mesh_id == 0 || !id_in_vector(found_device->mesh_id, linked_mesh_ids)) {
       // unknown mesh_id then the device is definitly not in reach of our current connection
-      if (found_device->mesh_id == 0) {
-        ESP_LOGD(TAG, "Try to connecty to device %s no mesh id known yet", found_device->device.address_str().c_str());
-        return found_device;
+      gain = 1;
+
+      // Reach remembered from before the last reboot, part of it can already be linked
+      Device *device = this->get_device(found_device->device.address_uint64());
+      if (device != nullptr && device->known_reach > 0) {
+        gain = std::max(gain, device->known_reach - (int) linked_mesh_ids.size());
+      }
+    }
+
+    if (gain > best_gain) {
+      best = found_device;
+      best_gain = gain;
+    }
+  }
+
+  if (best != nullptr) {
+    ESP_LOGD(TAG, "Try to connecty to device %s [%u] expected to add %d mesh id's (%d known reachable)",
+             best->device.address_str().c_str(), best->mesh_id, best_gain, best->reachable_mesh_ids.size());
+  }
+
+  return best;
+}
+
+bool AwoxMesh::connect_allowed(FoundDevice *found_device, const uint32_t now) const {
+  if (found_device->pairing_rejections >= this->max_pairing_rejections) {
+    ESP_LOGV(TAG, "Skip %s, mesh credentials rejected %u times", found_device->device.address_str().c_str(),
+             found_device->pairing_rejections);
+    return false;
+  }
+
+  if (found_device->failed_attempts == 0) {
+    return true;
+  }
+
+  const uint32_t backoff = std::min<uint32_t>(
+      this->connect_backoff_min_ms << std::min<uint8_t>(found_device->failed_attempts - 1, 10),
+      this->connect_backoff_max_ms);
+
+  return now - found_device->last_failed_attempt >= backoff;
+}
+
+FoundDevice *AwoxMesh::replacement_for(MeshConnection *connection) {
+  const std::vector<int> &linked_mesh_ids = connection->get_linked_mesh_ids();
+  const uint32_t now = esphome::millis();
+
+  FoundDevice *best = nullptr;
+  int best_covered = 0;
+  for (auto *found_device : this->found_devices_) {
+    if (found_device->connected || found_device->rssi < this->minimum_rssi ||
+        found_device->reachable_mesh_ids.empty() || !this->connect_allowed(found_device, now)) {
+      continue;
+    }
+    // Only a stronger signal is an improvement
+    if (connection->get_link_rssi() != 0 && found_device->rssi <= connection->get_link_rssi()) {
+      continue;
+    }
+
+    const int covered =
+        linked_mesh_ids.size() - count_missing_mesh_ids(linked_mesh_ids, found_device->reachable_mesh_ids);
+    if (covered > best_covered) {
+      best = found_device;
+      best_covered = covered;
+    }
+  }
+
+  return best;
+}
+
+void AwoxMesh::manage_handover() {
+  if (this->handover_to_ >= 0) {
+    MeshConnection *degraded = this->connections_[this->handover_from_];
+    MeshConnection *replacement = this->connections_[this->handover_to_];
+
+    if (replacement->establishing()) {
+      return;
+    }
+
+    if (replacement->get_slot_state() != SLOT_READY || degraded->get_slot_state() != SLOT_READY) {
+      ESP_LOGI(TAG, "Handover from connection %d to %d stopped", this->handover_from_, this->handover_to_);
+      this->handover_from_ = -1;
+      this->handover_to_ = -1;
+      return;
+    }
+
+    const std::vector<int> &degraded_ids = degraded->get_linked_mesh_ids();
+    const std::vector<int> &replacement_ids = replacement->get_linked_mesh_ids();
+    if (!std::includes(replacement_ids.begin(), replacement_ids.end(), degraded_ids.begin(), degraded_ids.end())) {
+      if (esphome::millis() - replacement->get_slot_state_since() > this->handover_timeout_ms) {
+        ESP_LOGI(TAG, "Handover from connection %d to %d stopped, not all mesh id's reachable",
+                 this->handover_from_, this->handover_to_);
+        this->handover_from_ = -1;
+        this->handover_to_ = -1;
+      }
+      return;
+    }
+
+    ESP_LOGI(TAG, "Handover from connection %d [%s] to %d [%s]", this->handover_from_, degraded->address_str(),
+             this->handover_to_, replacement->address_str());
+    replacement->add_queued_commands(degraded->take_queued_commands());
+    this->handover_from_ = -1;
+    this->handover_to_ = -1;
+
+    degraded->disconnect();
+    degraded->set_address(0);
+    return;
+  }
+
+  for (int i = 0; i < this->connections_.size(); i++) {
+    if (!this->connections_[i]->degraded()) {
+      continue;
+    }
+
+    auto spare = std::find_if(this->connections_.begin(), this->connections_.end(),
+                              [](MeshConnection *connection) { return connection->get_slot_state() == SLOT_IDLE; });
+    if (spare == this->connections_.end()) {
+      return;
+    }
+
+    FoundDevice *found_device = this->replacement_for(this->connections_[i]);
+    if (found_device == nullptr) {
+      continue;
+    }
+
+    this->handover_from_ = i;
+    this->handover_to_ = spare - this->connections_.begin();
+    ESP_LOGI(TAG, "Connection %d [%s] degraded (link rssi: %d), connect %s => rssi: %d as replacement", i,
+             this->connections_[i]->address_str(), this->connections_[i]->get_link_rssi(),
+             found_device->device.address_str().c_str(), (int) found_device->rssi);
+    (*spare)->connect_to(found_device);
+    return;
+  }
+}
+
+bool AwoxMesh::mesh_id_linked_elsewhere(int mesh_id, MeshConnection *connection) {
+  for (auto *other : this->connections_) {
+    if (other != connection && other->connected() && other->mesh_id_linked(mesh_id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void AwoxMesh::reroute_commands(MeshConnection *connection, std::deque<QueuedCommand> &&commands) {
+  const uint32_t now = esphome::millis();
+  int rerouted = 0;
+  int dropped = 0;
+
+  for (QueuedCommand &command : commands) {
+    if (now - command.queued_at > this->command_max_age_ms) {
+      dropped++;
+      continue;
+    }
+
+    // Same selection as call_connection(): a connection linking the destination, otherwise any live connection
+    MeshConnection *target = nullptr;
+    for (auto *other : this->connections_) {
+      if (other == connection || !other->connected() || other->get_slot_state() != SLOT_READY) {
+        continue;
+      }
+      if (other->mesh_id_linked(command.dest)) {
+        target = other;
+        break;
       }
-      // No active connection for found device
-      if (!id_in_vector(found_device->mesh_id, linked_mesh_ids)) {
-        ESP_LOGD(TAG, "Try to connecty to device %s [%u] no active connection found for this device",
-                 found_device->device.address_str().c_str(), found_device->mesh_id);
-        return found_device;
+      if (target == nullptr) {
+        target = other;
       }
     }
+
+    if (target == nullptr) {
+      dropped++;
+      continue;
+    }
+    target->add_queued_command(std::move(command));
+    rerouted++;
   }
 
-  return nullptr;
+  ESP_LOGI(TAG, "Pending commands of disconnected %s: %d rerouted, %d dropped", connection->address_str(), rerouted,
+           dropped);
+}
+
+void AwoxMesh::update_partition() {
+  const uint32_t now = esphome::millis();
+  if (!global_mqtt_client->is_connected()) {
+    this->partition_connected_since_ = 0;
+    return;
+  }
+  if (this->partition_connected_since_ == 0) {
+    // Give the retained announcements of the other hubs a moment to arrive
+    this->partition_connected_since_ = now;
+    return;
+  }
+
+  std::map<int, int> reach;
+  for (auto *connection : this->connections_) {
+    if (connection->connected()) {
+      for (int mesh_id : connection->get_linked_mesh_ids()) {
+        reach[mesh_id] = PARTITION_RSSI_UNKNOWN;
+      }
+    }
+  }
+  for (auto *found_device : this->found_devices_) {
+    if (found_device->mesh_id == 0 || found_device->rssi == RSSI_NOT_AVAILABLE) {
+      continue;
+    }
+    auto entry = reach.emplace(found_device->mesh_id, found_device->rssi).first;
+    entry->second = std::max(entry->second, found_device->rssi);
+  }
+  this->partition_.set_own_reach(std::move(reach));
+
+  const bool announce = !this->partition_settled_ ||
+                        now - this->last_partition_announcement_ >= this->partition_announce_interval_ms;
+  this->partition_settled_ = true;
+  this->apply_partition(announce);
+}
+
+void AwoxMesh::process_partition_announcement(const std::string &hub_id, HubAnnouncement &&announcement) {
+  announcement.received = esphome::millis();
+  const size_t reach = announcement.reach.size();
+  const size_t claims = announcement.claims.size();
+  if (this->partition_.process_announcement(hub_id, std::move(announcement))) {
+    ESP_LOGI(TAG, "Hub %s shares the mesh, reaches %d and claims %d mesh ids", hub_id.c_str(), reach, claims);
+  }
+  if (this->partition_settled_) {
+    this->apply_partition(false);
+  }
+}
+
+void AwoxMesh::apply_partition(bool announce) {
+  for (const std::string &hub_id : this->partition_.expire_hubs(esphome::millis())) {
+    ESP_LOGI(TAG, "Hub %s did not announce itself for %u ms, release its mesh ids", hub_id.c_str(),
+             this->partition_.get_expire_time());
+  }
+
+  const std::set<int> previous_claims = this->partition_.get_own_claims();
+  if (this->partition_.update()) {
+    announce = true;
+    ESP_LOGI(TAG, "Claims %d of %d reachable mesh ids (was %d), %d hubs share the mesh",
+             this->partition_.get_own_claims().size(), this->partition_.get_own_reach().size(), previous_claims.size(),
+             this->partition_.get_hub_count());
+
+    for (Device *device : this->mesh_devices_) {
+      const bool owned = this->partition_.get_own_claims().count(device->mesh_id);
+      if (owned == (previous_claims.count(device->mesh_id) > 0)) {
+        continue;
+      }
+      if (owned && device->address_set()) {
+        // The previous owner replaced the discovery message, take it back
+        ESP_LOGI(TAG, "Mesh_id: %u claimed from another hub", device->mesh_id);
+        this->publish_connection->resend_discovery(device);
+      } else if (!owned) {
+        ESP_LOGI(TAG, "Mesh_id: %u handed over to another hub", device->mesh_id);
+      }
+    }
+  }
+
+  if (announce) {
+    this->last_partition_announcement_ = esphome::millis();
+    this->publish_connection->publish_partition(this->partition_);
+  }
+}
+
+void AwoxMesh::check_primary() {
+  const uint32_t now = esphome::millis();
+  if (!global_mqtt_client->is_connected()) {
+    // Without MQTT there is no way to tell if the primary is still alive
+    this->last_primary_heartbeat_ = now;
+    return;
+  }
+
+  if (!this->standby_active_ &&
+      now - this->last_primary_heartbeat_ > this->heartbeat_interval_ms * this->takeover_missed_heartbeats) {
+    this->take_over("heartbeat missed");
+  }
+}
+
+void AwoxMesh::primary_heartbeat(int online_devices) {
+  this->last_primary_heartbeat_ = esphome::millis();
+  if (!this->standby_active_) {
+    return;
+  }
+
+  // A primary that just rebooted has no connections yet, keep the mesh connected until it reaches devices again
+  this->primary_ready_heartbeats_ = online_devices > 0 ? this->primary_ready_heartbeats_ + 1 : 0;
+  if (this->primary_ready_heartbeats_ >= this->handback_heartbeats) {
+    this->return_to_standby();
+  } else {
+    ESP_LOGD(TAG, "Primary %s is back with %d online devices", this->standby_for_.c_str(), online_devices);
+  }
+}
+
+void AwoxMesh::primary_offline() {
+  if (!this->standby_active_) {
+    this->take_over("primary went offline");
+  }
+}
+
+void AwoxMesh::take_over(const char *reason) {
+  ESP_LOGW(TAG, "Take over from %s, %s", this->standby_for_.c_str(), reason);
+  this->standby_active_ = true;
+  this->primary_ready_heartbeats_ = 0;
+
+  // Connection targets are known from scanning while in standby
+  this->ready_to_connect = true;
+  this->last_empty_candidate_search = 0;
+
+  // Point Home Assistant to the topics of this hub
+  this->publish_connection->announce_takeover();
+  this->publish_connection->force_resend_discovery();
+}
+
+void AwoxMesh::return_to_standby() {
+  ESP_LOGW(TAG, "Primary %s is back, return to standby", this->standby_for_.c_str());
+  this->standby_active_ = false;
+
+  this->pending_state_publish_.clear();
+  this->pending_group_sync_.clear();
+  this->availability_.cancel_pending();
+  this->deadlines_.remove(DEADLINE_AVAILABILITY_PUBLISH);
+
+  for (auto *connection : this->connections_) {
+    if (connection->get_address() != 0) {
+      connection->disconnect();
+      connection->set_address(0);
+    }
+  }
+}
+
+void AwoxMesh::connection_ready(FoundDevice *found_device) {
+  if (found_device == nullptr) {
+    return;
+  }
+  found_device->failed_attempts = 0;
+  found_device->pairing_rejections = 0;
+}
+
+void AwoxMesh::connection_failed(FoundDevice *found_device, bool pairing_rejected) {
+  if (found_device == nullptr) {
+    return;
+  }
+
+  if (found_device->failed_attempts < UINT8_MAX) {
+    found_device->failed_attempts++;
+  }
+  found_device->last_failed_attempt = esphome::millis();
+
+  if (pairing_rejected) {
+    found_device->pairing_rejections++;
+    if (found_device->pairing_rejections == this->max_pairing_rejections) {
+      ESP_LOGE(TAG, "%s rejected the mesh credentials %u times, it won't be used for connections anymore",
+               found_device->device.address_str().c_str(), found_device->pairing_rejections);
+    }
+  }
+
+  ESP_LOGI(TAG, "Connection to %s failed %u times in a row", found_device->device.address_str().c_str(),
+           found_device->failed_attempts);
 }
 
 void AwoxMesh::set_rssi_for_devices_that_are_not_available() {
-  this->last_found_device_cleanup = esphome::millis();
+  const uint32_t now = esphome::millis();
   for (auto *found_device : this->found_devices_) {
-    if (found_device->rssi > RSSI_NOT_AVAILABLE &&
-        this->last_found_device_cleanup - found_device->last_detected > 20000) {
+    if (found_device->rssi > RSSI_NOT_AVAILABLE && now - found_device->last_detected > 20000) {
       ESP_LOGD(TAG, "Clear RSSI for %s [%u] not found the last 20 seconds", found_device->device.address_str().c_str(),
                found_device->mesh_id);
       found_device->rssi = RSSI_NOT_AVAILABLE;
+      found_device->rssi_estimator.reset();
     }
   }
 }
@@ -316,6 +871,18 @@ bool AwoxMesh::mesh_id_allowed(int mesh_id) {
   return position != this->allowed_mesh_ids_.end();
 }
 
+bool AwoxMesh::mesh_id_owned(int mesh_id) {
+  if (!this->active()) {
+    return false;
+  }
+
+  if (this->partitioning_ && !(this->partition_settled_ && this->partition_.owns(mesh_id))) {
+    return false;
+  }
+
+  return this->mesh_id_allowed(mesh_id);
+}
+
 Device *AwoxMesh::get_device(const uint64_t address) {
   auto found = std::find_if(this->mesh_devices_.begin(), this->mesh_devices_.end(),
                             [address](const Device *_f) { return _f->address_uint64() == address; });
@@ -328,6 +895,12 @@ Device *AwoxMesh::get_device(const uint64_t address) {
 }
 
 Device *AwoxMesh::get_device(int mesh_id) {
+  // Mesh ids can move to another hub when partitioning, so also check known devices
+  if (!this->mesh_id_owned(mesh_id)) {
+    ESP_LOGV(TAG, "Mesh_id: %u ignored, not part of allowed_mesh_ids or owned by another hub", mesh_id);
+    return nullptr;
+  }
+
   auto found = std::find_if(this->mesh_devices_.begin(), this->mesh_devices_.end(),
                             [mesh_id](const Device *_f) { return _f->mesh_id == mesh_id; });
 
@@ -338,13 +911,9 @@ Device *AwoxMesh::get_device(int mesh_id) {
     return ptr;
   }
 
-  if (!this->mesh_id_allowed(mesh_id)) {
-    ESP_LOGV(TAG, "Mesh_id: %u ignored, not part of allowed_mesh_ids", mesh_id);
-    return nullptr;
-  }
-
   Device *device = new Device;
   device->mesh_id = mesh_id;
+  device->index = this->mesh_devices_.size();
   this->mesh_devices_.push_back(device);
 
   ESP_LOGI(TAG, "Added mesh_id: %d, Number of found mesh devices = %d", device->mesh_id, this->mesh_devices_.size());
@@ -368,7 +937,8 @@ Group *AwoxMesh::get_group(int dest, Device *device) {
     group->add_device(device);
     device->add_group(group);
 
-    this->sync_and_publish_group_state(group);
+    this->schedule_group_sync(group);
+    this->schedule_topology_save();
     return group;
   }
 
@@ -380,10 +950,12 @@ Group *AwoxMesh::get_group(int dest, Device *device) {
   device->add_group(group);
 
   this->mesh_groups_.push_back(group);
+  this->deadlines_.push(esphome::millis(), DEADLINE_GROUP_DISCOVERY, group);
 
   ESP_LOGI(TAG, "Added group_id: %d, Number of found mesh groups = %d", dest, this->mesh_groups_.size());
 
-  this->sync_and_publish_group_state(group);
+  this->schedule_group_sync(group);
+  this->schedule_topology_save();
 
   return group;
 }
@@ -391,32 +963,143 @@ Group *AwoxMesh::get_group(int dest, Device *device) {
 void AwoxMesh::publish_connected() {
   this->has_active_connection = false;
   int active_connections = 0;
-  int online_devices = 0;
 
-  std::vector<int> linked_mesh_ids;
-  for (auto *connection : this->connections_) {
-    if (connection->connected()) {
+  bool linked_mesh_ids_changed = this->online_devices_versions_.size() != this->connections_.size();
+  this->online_devices_versions_.resize(this->connections_.size());
+
+  for (int i = 0; i < this->connections_.size(); i++) {
+    uint32_t version = 0;
+    if (this->connections_[i]->connected()) {
       active_connections++;
       this->has_active_connection = true;
-      copy(connection->get_linked_mesh_ids().begin(), connection->get_linked_mesh_ids().end(),
-           std::back_inserter(linked_mesh_ids));
+      version = this->connections_[i]->get_linked_mesh_ids_version();
+    }
+    if (this->online_devices_versions_[i] != version) {
+      this->online_devices_versions_[i] = version;
+      linked_mesh_ids_changed = true;
     }
   }
-  sort(linked_mesh_ids.begin(), linked_mesh_ids.end());
-  linked_mesh_ids.erase(unique(linked_mesh_ids.begin(), linked_mesh_ids.end()), linked_mesh_ids.end());
-  online_devices = linked_mesh_ids.size();
 
-  this->publish_connection->publish_connected(active_connections, online_devices, this->connections_);
+  if (this->has_active_connection && this->statistics_.boot_to_ready_ms == 0) {
+    this->statistics_.boot_to_ready_ms = esphome::millis() - this->start;
+    ESP_LOGI(TAG, "First connection ready %u ms after boot", this->statistics_.boot_to_ready_ms);
+  }
+
+  // Only rebuild the union of linked mesh ids when one of the connections changed
+  if (linked_mesh_ids_changed) {
+    std::vector<int> linked_mesh_ids;
+    for (auto *connection : this->connections_) {
+      if (connection->connected()) {
+        copy(connection->get_linked_mesh_ids().begin(), connection->get_linked_mesh_ids().end(),
+             std::back_inserter(linked_mesh_ids));
+      }
+    }
+    sort(linked_mesh_ids.begin(), linked_mesh_ids.end());
+    linked_mesh_ids.erase(unique(linked_mesh_ids.begin(), linked_mesh_ids.end()), linked_mesh_ids.end());
+    this->online_devices_ = linked_mesh_ids.size();
+    this->schedule_topology_save();
+  }
+
+  this->publish_connection->publish_connected(active_connections, this->online_devices_, this->connections_);
+
+  this->update_scan_mode();
+}
+
+void AwoxMesh::update_scan_mode() {
+  if (!this->adaptive_scan_) {
+    return;
+  }
+
+  // Keep scanning at full speed while connecting, during a handover or when a device is not reachable
+  bool covered = this->has_active_connection && this->handover_to_ < 0;
+  for (auto *connection : this->connections_) {
+    if (connection->establishing() || connection->degraded()) {
+      covered = false;
+    }
+  }
+  for (auto *found_device : this->found_devices_) {
+    if (!covered) {
+      break;
+    }
+    if (found_device->mesh_id == 0 || found_device->rssi == RSSI_NOT_AVAILABLE ||
+        !this->mesh_id_owned(found_device->mesh_id)) {
+      continue;
+    }
+    covered = this->mesh_id_linked_elsewhere(found_device->mesh_id, nullptr);
+  }
+
+  if (!covered) {
+    this->coverage_complete_since_ = 0;
+    this->set_low_duty_scan(false);
+    return;
+  }
+
+  const uint32_t now = esphome::millis();
+  if (this->coverage_complete_since_ == 0) {
+    this->coverage_complete_since_ = now;
+  }
+  if (now - this->coverage_complete_since_ > this->low_duty_scan_delay_ms) {
+    this->set_low_duty_scan(true);
+  }
+}
+
+void AwoxMesh::set_low_duty_scan(bool low_duty_scan) {
+  if (this->low_duty_scan_ == low_duty_scan) {
+    return;
+  }
+  this->low_duty_scan_ = low_duty_scan;
+  this->statistics_.low_duty_scan = low_duty_scan ? 1 : 0;
+  this->statistics_.scan_mode_changes++;
+
+  uint32_t scan_window = this->scan_window_;
+  if (low_duty_scan) {
+    // 4 (2.5 ms) is the minimal scan window
+    scan_window = std::max<uint32_t>(this->scan_window_ / this->low_duty_scan_divider, 4);
+  }
+  ESP_LOGI(TAG, "Scan with %s duty cycle, window %u ms of %u ms", low_duty_scan ? "low" : "full",
+           scan_window * 5 / 8, this->scan_interval_ * 5 / 8);
+
+  // New scan parameters are only used when the scan is started again
+  auto *tracker = esp32_ble_tracker::global_esp32_ble_tracker;
+  tracker->set_scan_window(scan_window);
+  tracker->stop_scan();
+  this->set_timeout("restart_scan", 200, [tracker]() {
+    tracker->set_scan_continuous(true);
+    tracker->start_scan();
+  });
+}
+
+void AwoxMesh::record_command_latency(uint32_t latency) {
+  uint32_t &average = this->low_duty_scan_ ? this->statistics_.command_latency_low_duty_scan_ms
+                                           : this->statistics_.command_latency_full_scan_ms;
+  average = average == 0 ? latency : (average * 7 + latency) / 8;
 }
 
 void AwoxMesh::publish_availability(Device *device, bool delayed) {
+  if (!this->active()) {
+    return;
+  }
+
+  if (device->online && device->topology_stale) {
+    ESP_LOGD(TAG, "Cached info of %u is outdated, request info again", device->mesh_id);
+    device->topology_stale = false;
+    this->request_device_info(device);
+  }
+
   if (delayed) {
-    PublishOnlineStatus publish = {};
-    publish.device = device;
-    publish.online = device->online;
-    publish.time = esphome::millis();
-    this->delayed_availability_publish.push_back(publish);
-    ESP_LOGD(TAG, "Delayed publish online/offline for %d - %s", device->mesh_id, device->online ? "online" : "offline");
+    const bool published = this->publish_connection->availability_published(device, device->online);
+    const AvailabilityObservation observation =
+        this->availability_.observe(device->index, device->online, published, esphome::millis());
+    if (observation == AVAILABILITY_SCHEDULED) {
+      this->deadlines_.push(this->availability_.get_deadline(device->index), DEADLINE_AVAILABILITY_PUBLISH, device);
+    }
+    if (observation != AVAILABILITY_PUBLISHED) {
+      ESP_LOGD(TAG, "Delayed publish online/offline for %d - %s", device->mesh_id,
+               device->online ? "online" : "offline");
+    } else {
+      ESP_LOGD(TAG, "Skipped publishing availability for %u - %s (is published already, %u flaps)", device->mesh_id,
+               device->online ? "online" : "offline", this->availability_.get_flaps(device->index));
+    }
 
     return;
   }
@@ -428,7 +1111,7 @@ void AwoxMesh::publish_availability(Device *device, bool delayed) {
   }
 }
 
-void AwoxMesh::sync_and_publish_group_state(Group *group) {
+void AwoxMesh::sync_group_state(Group *group) {
   bool online = false;
   bool state = false;
 
@@ -450,6 +1133,7 @@ void AwoxMesh::sync_and_publish_group_state(Group *group) {
   for (Device *device : group->get_devices()) {
     if (group->device_info == nullptr && device->device_info != nullptr) {
       group->device_info = device->device_info;
+      this->deadlines_.push(esphome::millis(), DEADLINE_GROUP_DISCOVERY, group);
     }
     if (device->online) {
       online = true;
@@ -525,20 +1209,114 @@ void AwoxMesh::sync_and_publish_group_state(Group *group) {
   } else {
     ESP_LOGV(TAG, "No sync of group state, %s", group->state_as_string().c_str());
   }
-
-  this->publish_state(group);
 }
 
 void AwoxMesh::publish_state(MeshDestination *mesh_destination) {
   ESP_LOGV(TAG, "Publish: %s", mesh_destination->state_as_string().c_str());
-  this->publish_connection->publish_state(mesh_destination);
+  this->schedule_state_publish(mesh_destination);
 
   for (Group *group : mesh_destination->get_groups()) {
-    this->sync_and_publish_group_state(group);
+    this->schedule_group_sync(group);
   }
 }
 
+void AwoxMesh::schedule_state_publish(MeshDestination *mesh_destination) {
+  this->statistics_.state_publish_requests++;
+
+  if (mesh_destination->state_publish_pending) {
+    ESP_LOGVV(TAG, "[%d] State publication already pending", mesh_destination->dest());
+    return;
+  }
+
+  mesh_destination->state_publish_pending = true;
+  this->pending_state_publish_.push_back(mesh_destination);
+}
+
+void AwoxMesh::schedule_group_sync(Group *group) {
+  this->statistics_.state_publish_requests++;
+
+  // Multiple member reports in the same burst result in 1 sync + publication of the group
+  if (group->sync_pending) {
+    ESP_LOGVV(TAG, "[%d] Group sync already pending", group->dest());
+    return;
+  }
+
+  group->sync_pending = true;
+  this->pending_group_sync_.push_back(group);
+}
+
+bool AwoxMesh::state_publish_allowed(MeshDestination *mesh_destination, const uint32_t now) const {
+  return mesh_destination->last_state_publish == 0 ||
+         now - mesh_destination->last_state_publish >= this->state_publish_interval_ms;
+}
+
+void AwoxMesh::flush_pending_state_publish() {
+  if (this->pending_state_publish_.empty() && this->pending_group_sync_.empty()) {
+    return;
+  }
+
+  const uint32_t now = esphome::millis();
+
+  auto it = this->pending_state_publish_.begin();
+  while (it != this->pending_state_publish_.end()) {
+    MeshDestination *mesh_destination = *it;
+    if (!this->state_publish_allowed(mesh_destination, now)) {
+      ++it;
+      continue;
+    }
+    it = this->pending_state_publish_.erase(it);
+
+    mesh_destination->state_publish_pending = false;
+    mesh_destination->last_state_publish = now;
+    if (this->publish_connection->publish_state(mesh_destination)) {
+      this->statistics_.state_publish_sent++;
+    }
+  }
+
+  auto group_it = this->pending_group_sync_.begin();
+  while (group_it != this->pending_group_sync_.end()) {
+    Group *group = *group_it;
+    if (!this->state_publish_allowed(group, now)) {
+      ++group_it;
+      continue;
+    }
+    group_it = this->pending_group_sync_.erase(group_it);
+
+    group->sync_pending = false;
+    group->last_state_publish = now;
+    this->sync_group_state(group);
+    if (this->publish_connection->publish_state(group)) {
+      this->statistics_.state_publish_sent++;
+    }
+  }
+}
+
+void AwoxMesh::publish_statistics() {
+  for (auto *connection : this->connections_) {
+    this->statistics_.connection_heap_cost =
+        std::max(this->statistics_.connection_heap_cost, (uint32_t) connection->get_heap_cost());
+  }
+
+  std::map<int, uint16_t> availability_flaps;
+  this->statistics_.availability_flaps = this->availability_.get_flaps();
+  if (this->statistics_.availability_flaps > 0) {
+    for (auto *device : this->mesh_devices_) {
+      const uint16_t flaps = this->availability_.get_flaps(device->index);
+      if (flaps > 0) {
+        availability_flaps[device->mesh_id] = flaps;
+      }
+    }
+  }
+
+  this->publish_connection->publish_statistics(this->statistics_, availability_flaps,
+                                               heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+}
+
 void AwoxMesh::send_discovery(Device *device) {
+  if (!this->mesh_id_owned(device->mesh_id)) {
+    return;
+  }
+
   if (!device->address_set()) {
     ESP_LOGW(TAG, "'%s': Can not yet send discovery, mac address not known...",
              std::to_string(device->mesh_id).c_str());
@@ -549,9 +1327,188 @@ void AwoxMesh::send_discovery(Device *device) {
   device->send_discovery = true;
 
   this->publish_connection->send_discovery(device);
+  this->schedule_topology_save();
+}
+
+void AwoxMesh::restore_topology() {
+  int restored = 0;
+
+  for (int i = 0; i < TOPOLOGY_CACHE_CHUNKS; i++) {
+    this->topology_preferences_[i] =
+        global_preferences->make_preference<TopologyChunk>(fnv1_hash("awox_mesh_topology_" + std::to_string(i)), true);
+
+    TopologyChunk chunk{};
+    if (!this->topology_preferences_[i].load(&chunk)) {
+      continue;
+    }
+
+    for (const TopologyEntry &entry : chunk.entries) {
+      if (entry.mesh_id == 0 || !this->mesh_id_allowed(entry.mesh_id)) {
+        continue;
+      }
+
+      TopologyEntry restored_entry = entry;
+      restored_entry.age = entry.age < 0xFF ? entry.age + 1 : entry.age;
+      this->restore_topology_entry(restored_entry);
+      restored++;
+    }
+  }
+
+  ESP_LOGI(TAG, "Restored %d mesh devices and %d groups from the topology cache", restored, this->mesh_groups_.size());
+}
+
+void AwoxMesh::restore_topology_entry(const TopologyEntry &entry) {
+  Device *device = new Device;
+  device->mesh_id = entry.mesh_id;
+  device->set_address(entry.mac[0], entry.mac[1], entry.mac[2], entry.mac[3]);
+  device->product_id = entry.product_id;
+  device->known_reach = entry.reach;
+  device->topology_age = entry.age;
+  device->topology_stale = device->topology_age > TOPOLOGY_CACHE_MAX_AGE;
+  device->index = this->mesh_devices_.size();
+  this->mesh_devices_.push_back(device);
+
+  this->send_discovery(device);
+
+  for (uint8_t group_id : entry.groups) {
+    if (group_id == TOPOLOGY_CACHE_NO_GROUP) {
+      break;
+    }
+    this->get_group(group_id, device);
+  }
+}
+
+void AwoxMesh::apply_topology_chunk(const TopologyChunk &chunk) {
+  int added = 0;
+  for (const TopologyEntry &entry : chunk.entries) {
+    if (entry.mesh_id == 0 || !this->mesh_id_allowed(entry.mesh_id)) {
+      continue;
+    }
+
+    auto found = std::find_if(this->mesh_devices_.begin(), this->mesh_devices_.end(),
+                              [&entry](const Device *_f) { return _f->mesh_id == entry.mesh_id; });
+    if (found != this->mesh_devices_.end()) {
+      continue;
+    }
+
+    this->restore_topology_entry(entry);
+    added++;
+  }
+
+  if (added > 0) {
+    ESP_LOGI(TAG, "Added %d mesh devices from the topology of %s", added, this->standby_for_.c_str());
+    this->schedule_topology_save();
+  }
+}
+
+void AwoxMesh::schedule_topology_save() {
+  if (!this->topology_cache_) {
+    return;
+  }
+
+  // Bundle all changes of a burst of reports in 1 write
+  this->set_timeout("save_topology", 10000, [this]() { this->save_topology(); });
+}
+
+void AwoxMesh::save_topology() {
+  TopologyChunk chunk{};
+  int chunk_index = 0;
+  int entry_index = 0;
+  int saved = 0;
+
+  for (Device *device : this->mesh_devices_) {
+    if (!device->address_set() || chunk_index == TOPOLOGY_CACHE_CHUNKS) {
+      continue;
+    }
+
+    TopologyEntry &entry = chunk.entries[entry_index];
+    const uint64_t address = device->address_uint64();
+
+    entry.mesh_id = device->mesh_id;
+    for (int i = 0; i < 4; i++) {
+      entry.mac[i] = (address >> (8 * (3 - i))) & 0xFF;
+    }
+    entry.product_id = device->product_id;
+    entry.age = device->topology_age;
+
+    memset(entry.groups, TOPOLOGY_CACHE_NO_GROUP, sizeof(entry.groups));
+    int group_index = 0;
+    for (Group *group : device->get_groups()) {
+      if (group_index == TOPOLOGY_CACHE_GROUPS) {
+        break;
+      }
+      entry.groups[group_index++] = group->group_id;
+    }
+
+    for (FoundDevice *found_device : this->found_devices_) {
+      if (found_device->device.address_uint64() == address && !found_device->reachable_mesh_ids.empty()) {
+        device->known_reach = std::min<size_t>(found_device->reachable_mesh_ids.size(), 0xFF);
+        break;
+      }
+    }
+    entry.reach = device->known_reach;
+    saved++;
+
+    if (++entry_index == TOPOLOGY_CACHE_CHUNK_ENTRIES) {
+      this->store_topology_chunk(chunk_index++, chunk);
+      chunk = {};
+      entry_index = 0;
+    }
+  }
+
+  // Also clears chunks that are no longer used
+  while (chunk_index < TOPOLOGY_CACHE_CHUNKS) {
+    this->store_topology_chunk(chunk_index++, chunk);
+    chunk = {};
+  }
+
+  ESP_LOGD(TAG, "Saved topology of %d mesh devices", saved);
+}
+
+void AwoxMesh::store_topology_chunk(int index, const TopologyChunk &chunk) {
+  this->topology_preferences_[index].save(&chunk);
+
+  // Shared with a standby hub, so it knows the devices before it has to take over
+  if (this->heartbeat_interval_ms > 0 && this->active()) {
+    this->publish_connection->publish_topology_chunk(index, chunk);
+  }
+}
+
+void AwoxMesh::resend_discovery() {
+  for (Device *device : this->mesh_devices_) {
+    if (device->address_set() && this->mesh_id_owned(device->mesh_id)) {
+      this->send_discovery(device);
+    }
+  }
+
+  for (Group *group : this->mesh_groups_) {
+    if (group->device_info != nullptr) {
+      this->send_group_discovery(group);
+    }
+  }
+
+  this->publish_connection->publish_connection_sensor_discovery(this->connections_);
+}
+
+void AwoxMesh::queue_republish() {
+  for (Device *device : this->mesh_devices_) {
+    if (device->send_discovery && this->mesh_id_owned(device->mesh_id)) {
+      this->publish_connection->queue_republish(device);
+    }
+  }
+
+  for (Group *group : this->mesh_groups_) {
+    if (group->send_discovery) {
+      this->publish_connection->queue_republish(group);
+    }
+  }
 }
 
 void AwoxMesh::send_group_discovery(Group *group) {
+  if (!this->active()) {
+    return;
+  }
+
   if (group->device_info == nullptr) {
     ESP_LOGW(TAG, "'%s': Can not yet send discovery, component_type not known...",
              std::to_string(group->group_id).c_str());
@@ -565,8 +1522,14 @@ void AwoxMesh::send_group_discovery(Group *group) {
 
 void AwoxMesh::call_connection(int dest, std::function<void(MeshConnection *)> &&callback) {
   ESP_LOGD(TAG, "Call connection for %d", dest);
+  MeshConnection *degraded = nullptr;
   for (auto *connection : this->connections_) {
     if (connection->get_address() > 0 && connection->mesh_id_linked(dest)) {
+      // Prefer a healthy connection, relevant during a handover
+      if (connection->degraded()) {
+        degraded = degraded == nullptr ? connection : degraded;
+        continue;
+      }
       ESP_LOGD(TAG, "Found %s as connection", connection->address_str());
       callback(connection);
 
@@ -575,6 +1538,12 @@ void AwoxMesh::call_connection(int dest, std::function<void(MeshConnection *)> &
     }
   }
 
+  if (degraded != nullptr) {
+    ESP_LOGD(TAG, "Found degraded %s as connection", degraded->address_str());
+    callback(degraded);
+    return;
+  }
+
   ESP_LOGI(TAG, "No active connection for %d, we trigger message on all could be also a group", dest);
   for (auto *connection : this->connections_) {
     if (connection->connected()) {
@@ -584,8 +1553,12 @@ void AwoxMesh::call_connection(int dest, std::function<void(MeshConnection *)> &
 }
 
 void AwoxMesh::request_device_info(Device *device) {
+  // Retry also when no connection took the request, it is send once a connection is back
+  device->device_info_requested = esphome::millis();
+  this->deadlines_.push(device->device_info_requested + this->device_info_request_interval_ms,
+                        DEADLINE_DEVICE_INFO_RETRY, device);
+
   this->call_connection(device->mesh_id, [device](MeshConnection *connection) {
-    device->device_info_requested = esphome::millis();
     connection->request_device_info(device);
     connection->request_group_info(device);
     // connection->request_device_version(device->mesh_id);
@@ -634,6 +1607,20 @@ void AwoxMesh::set_sequence_color_duration(int dest, int duration) {
       dest, [dest, duration](MeshConnection *connection) { connection->set_sequence_color_duration(dest, duration); });
 }
 
+void AwoxMesh::send_command(const MeshCommand &command) {
+  this->call_connection(command.dest,
+                        [&command](MeshConnection *connection) { connection->queue_mesh_command(command); });
+}
+
+void AwoxMesh::send_commands(const MeshCommand *commands, uint8_t size) {
+  if (size == 0) {
+    return;
+  }
+
+  this->call_connection(commands[0].dest,
+                        [commands, size](MeshConnection *connection) { connection->queue_burst(commands, size); });
+}
+
 void AwoxMesh::request_status_update(int dest) {
   this->call_connection(dest, [dest](MeshConnection *connection) { connection->request_status_update(dest); });
 }
@@ -11,46 +11,74 @@
 #include "esphome/core/automation.h"
 #include "esphome/core/component.h"
 #include "esphome/core/defines.h"
+#include "esphome/core/preferences.h"
 
+#include "availability_hysteresis.h"
 #include "awox_mesh_mqtt.h"
+#include "deadline_queue.h"
+#include "mesh_command.h"
 #include "mesh_destination.h"
 #include "mesh_connection.h"
+#include "mesh_partition.h"
+#include "rssi_estimator.h"
 #include "device.h"
 #include "device_info.h"
 #include "group.h"
+#include "statistics.h"
+#include "topology_cache.h"
 
 namespace esphome {
 namespace awox_mesh {
 
 using namespace esp32_ble_client;
 
-struct PublishOnlineStatus {
-  Device *device;
-  bool online;
-  uint32_t time;
-};
-
 struct FoundDevice {
+  /** Confidence adjusted RSSI used for ranking, RSSI_NOT_AVAILABLE when not seen recently */
   int rssi{0};
+  RssiEstimator rssi_estimator{};
   uint32_t last_detected;
   esp32_ble_tracker::ESPBTDevice device;
   bool connected = false;
   int mesh_id;
+  /** Number of advertisements received */
+  uint16_t sightings = 0;
+  /** Sorted mesh ids ever reached through a connection with this device */
+  std::vector<int> reachable_mesh_ids{};
+  /** Connection attempts failed in a row, used for the backoff */
+  uint8_t failed_attempts = 0;
+  uint32_t last_failed_attempt = 0;
+  /** Number of times the device did not accept the mesh credentials */
+  uint8_t pairing_rejections = 0;
 };
 
 class AwoxMesh : public esp32_ble_tracker::ESPBTDeviceListener, public Component {
   uint32_t start;
   uint32_t device_info_request_interval_ms = 5000;
-  uint32_t delayed_availability_publish_debounce_time_ms = 3000;
+  uint32_t state_publish_interval_ms = 500;
+  /** Connect anyway when no device proved to be a good candidate within this time */
+  uint32_t start_up_max_delay_ms = 10000;
+  /** Number of advertisements before a device is a good enough candidate to connect to */
+  uint16_t start_up_min_sightings = 3;
+  /** Connection slots allowed to connect/authenticate at the same time */
+  int max_concurrent_connects = 2;
+  /** Backoff after a failed connection attempt, doubled for every next failure of the same device */
+  uint32_t connect_backoff_min_ms = 5000;
+  uint32_t connect_backoff_max_ms = 300000;
+  /** Devices that rejected the mesh credentials this many times are not used anymore */
+  uint8_t max_pairing_rejections = 3;
 
 
   bool ready_to_connect = false;
 
   bool has_active_connection = false;
 
-  uint32_t last_connection_attempt = 0;
+  /** Time of the last search for a device to connect to that found none, 0 to search again right away */
+  uint32_t last_empty_candidate_search = 0;
+  /** Idle slots search for a device again after this time when none was found, the backoff paces the retries */
+  uint32_t candidate_search_interval_ms = 1000;
 
-  uint32_t last_found_device_cleanup = 0;
+  /** Interval to clear the RSSI of devices that were not seen for 20 seconds */
+  uint32_t found_device_cleanup_interval_ms = 20000;
 
   int minimum_rssi = -90;
 
@@ -64,7 +92,77 @@ class AwoxMesh : public esp32_ble_tracker::ESPBTDeviceListener, public Component
 
   DeviceInfoResolver *device_info_resolver = new DeviceInfoResolver();
 
-  std::deque<PublishOnlineStatus> delayed_availability_publish{};
+  /** Deadlines of devices and groups, so the loop doesn't have to check them all every time */
+  DeadlineQueue deadlines_{};
+
+  /** Debounced online/offline state per device */
+  AvailabilityTable availability_{};
+
+  std::vector<MeshDestination *> pending_state_publish_{};
+
+  std::vector<Group *> pending_group_sync_{};
+
+  MeshStatistics statistics_{};
+
+  /** Linked mesh ids version per connection (0 when not connected) used for the last online devices count */
+  std::vector<uint32_t> online_devices_versions_{};
+  int online_devices_ = 0;
+
+  bool topology_cache_ = true;
+
+  ESPPreferenceObject topology_preferences_[TOPOLOGY_CACHE_CHUNKS];
+
+  /** Connection slots of a running make-before-break handover, -1 when none */
+  int handover_from_ = -1;
+  int handover_to_ = -1;
+  /** Maximal time for the replacement to reach all mesh ids of the degraded connection */
+  uint32_t handover_timeout_ms = 10000;
+
+  /** Queued mesh commands older than this are dropped instead of send */
+  uint32_t command_max_age_ms = 10000;
+
+  /** Mesh ids are split with other hubs through the partition topic */
+  bool partitioning_ = false;
+  MeshPartition partition_{};
+  /** No mesh ids are owned until the retained announcements of the other hubs had a chance to arrive */
+  bool partition_settled_ = false;
+  uint32_t partition_connected_since_ = 0;
+  uint32_t last_partition_announcement_ = 0;
+  uint32_t partition_announce_interval_ms = 20000;
+
+  /** Interval of the `<prefix>/heartbeat` messages, 0 disables them */
+  uint32_t heartbeat_interval_ms = 0;
+  /** Topic prefix of the primary hub when this hub is its hot standby, empty otherwise */
+  std::string standby_for_ = "";
+  /** Standby took over from the primary */
+  bool standby_active_ = false;
+  uint32_t last_primary_heartbeat_ = 0;
+  /** Missed heartbeats of the primary before the standby takes over */
+  uint8_t takeover_missed_heartbeats = 3;
+  /** Heartbeats in a row with online devices before a standby that took over hands back to the primary */
+  uint8_t handback_heartbeats = 3;
+  uint8_t primary_ready_heartbeats_ = 0;
+
+  /** Scan with a low duty cycle while all advertising devices are linked */
+  bool adaptive_scan_ = false;
+  bool low_duty_scan_ = false;
+  /** Configured scan interval and window of the esp32_ble_tracker, in 0.625 ms units */
+  uint32_t scan_interval_ = 0;
+  uint32_t scan_window_ = 0;
+  /** The scan window is divided by this in low duty cycle mode */
+  uint32_t low_duty_scan_divider = 4;
+  /** Coverage has to be complete this long before the scan duty cycle is lowered */
+  uint32_t low_duty_scan_delay_ms = 30000;
+  uint32_t coverage_complete_since_ = 0;
+
+  /** Time between 2 liveness probes, from the packets per second budget, 0 disables probing */
+  uint32_t liveness_probe_interval_ms = 0;
+  /** Online devices silent for this time are probed with a status request */
+  uint32_t liveness_timeout_ms = 300000;
+  /** Time to wait for the answer on a liveness probe */
+  uint32_t liveness_probe_timeout_ms = 10000;
+  /** Unanswered probes before a device is marked offline */
+  uint8_t liveness_max_probes = 3;
 
   bool start_up_delay_done();
 
@@ -76,19 +174,69 @@ class AwoxMesh : public esp32_ble_tracker::ESPBTDeviceListener, public Component
 
   void set_rssi_for_devices_that_are_not_available();
 
+  void process_deadlines();
+
+  void probe_liveness(uint32_t now);
+
   void call_connection(int dest, std::function<void(MeshConnection *)> &&callback);
 
   void disconnect_connections_with_overlapping_mesh_ids();
 
+  void update_partition();
+
+  void apply_partition(bool announce);
+
+  void check_primary();
+
+  void update_scan_mode();
+
+  void set_low_duty_scan(bool low_duty_scan);
+
+  void take_over(const char *reason);
+
+  void return_to_standby();
+
+  void restore_topology_entry(const TopologyEntry &entry);
+
   void disconnect_connection_with_overlapping_mesh_ids(int a, int b);
 
   bool mesh_id_allowed(int mesh_id);
 
+  /** Allowed and, when partitioning, owned by this hub */
+  bool mesh_id_owned(int mesh_id);
+
+  bool connect_allowed(FoundDevice *found_device, uint32_t now) const;
+
+  FoundDevice *replacement_for(MeshConnection *connection);
+
+  void manage_handover();
+
+  bool in_handover(int connection_index) const {
+    return this->handover_to_ >= 0 &&
+           (connection_index == this->handover_from_ || connection_index == this->handover_to_);
+  }
+
   bool mac_addresses_allowed(const uint64_t address);
 
   void send_group_discovery(Group *group);
 
-  void sync_and_publish_group_state(Group *group);
+  void sync_group_state(Group *group);
+
+  void schedule_group_sync(Group *group);
+
+  void schedule_state_publish(MeshDestination *mesh_destination);
+
+  bool state_publish_allowed(MeshDestination *mesh_destination, uint32_t now) const;
+
+  void flush_pending_state_publish();
+
+  void restore_topology();
+
+  void save_topology();
+
+  void schedule_topology_save();
+
+  void store_topology_chunk(int index, const TopologyChunk &chunk);
 
  public:
   void set_mesh_name(const std::string &mesh_name) {
@@ -130,6 +278,58 @@ class AwoxMesh : public esp32_ble_tracker::ESPBTDeviceListener, public Component
 
   void set_min_rssi(int min_rssi) { this->minimum_rssi = min_rssi; }
 
+  void set_state_publish_interval(uint32_t interval) { this->state_publish_interval_ms = interval; }
+
+  void set_bulk_state_interval(uint32_t interval) { this->publish_connection->set_bulk_state_interval(interval); }
+
+  void set_discovery_rate(uint32_t messages_per_second, uint32_t bytes_per_second) {
+    this->publish_connection->set_discovery_rate(messages_per_second, bytes_per_second);
+  }
+
+  void set_discovery_abbreviations(bool enabled) { this->publish_connection->set_discovery_abbreviations(enabled); }
+
+  void set_binary_protocol(bool enabled) { this->publish_connection->set_binary_protocol(enabled); }
+
+  void set_topology_cache(bool enabled) { this->topology_cache_ = enabled; }
+
+  void set_availability_debounce(uint32_t online_debounce, uint32_t offline_debounce) {
+    this->availability_.set_online_debounce(online_debounce);
+    this->availability_.set_offline_debounce(offline_debounce);
+  }
+
+  void set_command_max_age(uint32_t command_max_age) { this->command_max_age_ms = command_max_age; }
+
+  void set_adaptive_scan(uint32_t scan_interval, uint32_t scan_window) {
+    this->adaptive_scan_ = true;
+    this->scan_interval_ = scan_interval;
+    this->scan_window_ = scan_window;
+  }
+
+  void set_liveness_probing(float probes_per_second, uint32_t timeout, uint8_t max_probes) {
+    this->liveness_probe_interval_ms = probes_per_second > 0 ? (uint32_t) (1000 / probes_per_second) : 0;
+    this->liveness_timeout_ms = timeout;
+    this->liveness_max_probes = max_probes;
+  }
+
+  void set_heartbeat_interval(uint32_t interval) { this->heartbeat_interval_ms = interval; }
+
+  void set_standby_for(const std::string &topic_prefix) {
+    this->standby_for_ = topic_prefix;
+    this->publish_connection->set_standby_for(topic_prefix);
+  }
+
+  /** Not a standby hub, or a standby that took over */
+  bool active() const { return this->standby_for_.empty() || this->standby_active_; }
+
+  void set_partition_topic(const std::string &topic) {
+    this->partitioning_ = true;
+    this->publish_connection->set_partition_topic(topic);
+  }
+
+  void set_max_concurrent_connects(int max_concurrent_connects) {
+    this->max_concurrent_connects = max_concurrent_connects;
+  }
+
   void loop() override;
 
   Device *get_device(int dest);
@@ -142,10 +342,36 @@ class AwoxMesh : public esp32_ble_tracker::ESPBTDeviceListener, public Component
 
   void send_discovery(Device *device);
 
+  void resend_discovery();
+
+  void queue_republish();
+
   void publish_state(MeshDestination *mesh_destination);
 
   void publish_connected();
 
+  void connection_ready(FoundDevice *found_device);
+
+  void connection_failed(FoundDevice *found_device, bool pairing_rejected);
+
+  bool mesh_id_linked_elsewhere(int mesh_id, MeshConnection *connection);
+
+  void reroute_commands(MeshConnection *connection, std::deque<QueuedCommand> &&commands);
+
+  void process_partition_announcement(const std::string &hub_id, HubAnnouncement &&announcement);
+
+  void record_command_latency(uint32_t latency);
+
+  void primary_heartbeat(int online_devices);
+
+  void primary_offline();
+
+  void apply_topology_chunk(const TopologyChunk &chunk);
+
+  void publish_statistics();
+
+  const MeshStatistics &get_statistics() const { return this->statistics_; }
+
   void set_power(int dest, bool state);
   void set_color(int dest, int red, int green, int blue);
   void set_color_brightness(int dest, int brightness);
@@ -156,6 +382,9 @@ class AwoxMesh : public esp32_ble_tracker::ESPBTDeviceListener, public Component
   void set_sequence_fade_duration(int dest, int duration);
   void set_sequence_color_duration(int dest, int duration);
 
+  void send_command(const MeshCommand &command);
+  void send_commands(const MeshCommand *commands, uint8_t size);
+
  protected:
   std::vector<MeshConnection *> connections_{};
   std::vector<FoundDevice *> found_devices_{};
@@ -9,29 +9,43 @@
 #include "esphome/components/mqtt/mqtt_const.h"
 #include "esphome/components/mqtt/mqtt_component.h"
 #include "esphome/core/application.h"
+#include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
 
 #include "awox_mesh_mqtt.h"
 #include "awox_mesh.h"
+#include "binary_protocol.h"
+#include "discovery_keys.h"
+#include "helpers.h"
+#include "light_command_json.h"
 
 namespace esphome {
 namespace awox_mesh {
 
 static const char *const TAG = "awox.mesh.mqtt";
 
-static int convert_value_to_available_range(int value, int min_from, int max_from, int min_to, int max_to) {
-  float normalized = (float) (value - min_from) / (float) (max_from - min_from);
-  int new_value = std::min((int) round((normalized * (float) (max_to - min_to)) + min_to), max_to);
-
-  return std::max(new_value, min_to);
-}
-
 static std::string get_product_code_as_hex_string(int product_id) {
   char value[15];
   sprintf(value, "Product: 0x%02X", product_id);
   return std::string((char *) value, 15);
 }
 
+/** Comma separated list of mesh ids, truncated to whole ids when the buffer is too small */
+static void format_mesh_ids(const std::vector<int> &mesh_ids, char *buffer, size_t size) {
+  size_t length = 0;
+  buffer[0] = '\0';
+
+  for (int mesh_id : mesh_ids) {
+    int written = snprintf(buffer + length, size - length, length == 0 ? "%d" : ", %d", mesh_id);
+    if (written < 0 || length + written >= size) {
+      buffer[length] = '\0';
+      break;
+    }
+    length += written;
+  }
+}
+
 void AwoxMeshMqtt::setup() {
   // Use retained MQTT messages to publish a default offline status for all devices
   global_mqtt_client->subscribe(
@@ -43,6 +57,58 @@ void AwoxMeshMqtt::setup() {
           }
         }
       });
+
+  global_mqtt_client->subscribe(global_mqtt_client->get_topic_prefix() + "/discovery/resend",
+                                [this](const std::string &topic, const std::string &payload) {
+                                  if (payload.empty()) {
+                                    return;
+                                  }
+                                  ESP_LOGI(TAG, "Forced resend of all discovery messages (%s)", payload.c_str());
+                                  this->force_resend_discovery();
+                                  // A standby leaves a retained request after it took over, handle it only once
+                                  global_mqtt_client->publish(topic, std::string(), 0, true);
+                                });
+
+  if (!this->standby_for_.empty()) {
+    global_mqtt_client->subscribe(this->standby_for_ + "/heartbeat",
+                                  [this](const std::string &topic, const std::string &payload) {
+                                    this->mesh_->primary_heartbeat(atoi(payload.c_str()));
+                                  });
+    global_mqtt_client->subscribe(this->standby_for_ + "/status",
+                                  [this](const std::string &topic, const std::string &payload) {
+                                    if (payload == "offline") {
+                                      this->mesh_->primary_offline();
+                                    }
+                                  });
+    global_mqtt_client->subscribe(this->standby_for_ + "/topology/+",
+                                  [this](const std::string &topic, const std::string &payload) {
+                                    if (payload.size() != sizeof(TopologyChunk)) {
+                                      return;
+                                    }
+                                    TopologyChunk chunk{};
+                                    memcpy(&chunk, payload.data(), sizeof(TopologyChunk));
+                                    this->mesh_->apply_topology_chunk(chunk);
+                                  });
+  }
+
+  // Home Assistant birth message, published when Home Assistant (re)started
+  global_mqtt_client->subscribe(global_mqtt_client->get_discovery_info().prefix + "/status",
+                                [this](const std::string &topic, const std::string &payload) {
+                                  this->process_home_assistant_status_(payload);
+                                });
+
+  if (!this->partition_topic_.empty()) {
+    global_mqtt_client->subscribe_json(
+        this->partition_topic_ + "/+",
+        [this](const std::string &topic, JsonObject root) { this->process_partition_announcement_(topic, root); });
+  }
+
+  if (this->binary_protocol_) {
+    global_mqtt_client->subscribe(global_mqtt_client->get_topic_prefix() + "/binary/command",
+                                  [this](const std::string &topic, const std::string &payload) {
+                                    this->process_incomming_binary_command(payload);
+                                  });
+  }
 }
 
 std::string AwoxMeshMqtt::get_discovery_topic_(const MQTTDiscoveryInfo &discovery_info, Device *device) const {
@@ -70,7 +136,13 @@ void AwoxMeshMqtt::publish_connected(int active_connections, int online_devices,
     global_mqtt_client->publish(global_mqtt_client->get_topic_prefix() + "/connected", message, 0, true);
   }
 
-  if (this->last_published_active_connections_ == active_connections &&
+  bool connection_status_changed = this->connection_status_.size() != connections.size();
+  this->connection_status_.resize(connections.size());
+  for (int i = 0; i < connections.size(); i++) {
+    connection_status_changed |= this->update_connection_status_(this->connection_status_[i], connections[i]);
+  }
+
+  if (!connection_status_changed && this->last_published_active_connections_ == active_connections &&
       this->last_published_online_devices_ == online_devices) {
     return;
   }
@@ -86,32 +158,54 @@ void AwoxMeshMqtt::publish_connected(int active_connections, int online_devices,
         root["active_connections"] = active_connections;
         root["online_devices"] = online_devices;
 
-        for (int i = 0; i < connections.size(); i++) {
+        for (int i = 0; i < this->connection_status_.size(); i++) {
+          const ConnectionStatus &status = this->connection_status_[i];
           JsonObject connection = root["connection_" + std::to_string(i)].to<JsonObject>();
-          connection["connected"] = connections[i]->connected();
-          connection["mac"] = connections[i]->connected() ? connections[i]->address_str() : "";
-          connection["mesh_id"] = connections[i]->connected() ? std::to_string(connections[i]->mesh_id()) : "";
-          connection["devices"] = connections[i]->get_linked_mesh_ids().size();
-
-          std::stringstream mesh_ids;
-          std::copy(connections[i]->get_linked_mesh_ids().begin(), connections[i]->get_linked_mesh_ids().end(),
-                    std::ostream_iterator<int>(mesh_ids, ", "));
-          connection["mesh_ids"] = mesh_ids.str().substr(0, mesh_ids.str().size() - 2);
+          connection["connected"] = status.connected;
+          connection["mac"] = status.mac;
+          connection["mesh_id"] = status.connected ? std::to_string(status.mesh_id) : "";
+          connection["devices"] = status.devices;
+          connection["mesh_ids"] = (const char *) status.mesh_ids;
         }
       },
       0, false);
 }
 
+/** Only re-render the fields of a connection when its state or linked mesh ids changed */
+bool AwoxMeshMqtt::update_connection_status_(ConnectionStatus &status, MeshConnection *connection) {
+  const bool connected = connection->connected();
+  const int mesh_id = connected ? connection->mesh_id() : 0;
+  const uint32_t version = connection->get_linked_mesh_ids_version();
+
+  if (status.connected == connected && status.mesh_id == mesh_id && status.linked_mesh_ids_version == version) {
+    return false;
+  }
+
+  status.connected = connected;
+  status.mesh_id = mesh_id;
+  status.linked_mesh_ids_version = version;
+  status.mac = connected ? connection->address_str() : "";
+  status.devices = connection->get_linked_mesh_ids().size();
+  format_mesh_ids(connection->get_linked_mesh_ids(), status.mesh_ids, sizeof(status.mesh_ids));
+
+  return true;
+}
+
 void AwoxMeshMqtt::publish_availability(Device *device) {
   if (this->last_published_availability_.count(device->dest()) &&
       this->last_published_availability_[device->dest()] == device->online) {
     return;
   }
-  this->last_published_availability_[device->dest()] = device->online;
 
   const std::string message = device->online ? "online" : "offline";
   ESP_LOGI(TAG, "Publish online/offline for device %u - %s", device->mesh_id, message.c_str());
-  global_mqtt_client->publish(this->get_mqtt_topic_for_(device, "availability"), message, 0, true);
+  // Only remember successful publications, so nothing is lost when MQTT isn't connected yet
+  if (!global_mqtt_client->publish(this->get_mqtt_topic_for_(device, "availability"), message, 0, true)) {
+    return;
+  }
+
+  this->last_published_availability_[device->dest()] = device->online;
+  this->update_bulk_state_entry_(device->dest());
 }
 
 void AwoxMeshMqtt::publish_availability(Group *group) {
@@ -119,17 +213,22 @@ void AwoxMeshMqtt::publish_availability(Group *group) {
       this->last_published_availability_[group->dest()] == group->online) {
     return;
   }
-  this->last_published_availability_[group->dest()] = group->online;
 
   const std::string message = group->online ? "online" : "offline";
   ESP_LOGI(TAG, "Publish online/offline for group %u - %s", group->group_id, message.c_str());
-  global_mqtt_client->publish(this->get_mqtt_topic_for_(group, "availability"), message, 0, true);
+  // Only remember successful publications, so nothing is lost when MQTT isn't connected yet
+  if (!global_mqtt_client->publish(this->get_mqtt_topic_for_(group, "availability"), message, 0, true)) {
+    return;
+  }
+
+  this->last_published_availability_[group->dest()] = group->online;
+  this->update_bulk_state_entry_(group->dest());
 }
 
-void AwoxMeshMqtt::publish_state(MeshDestination *mesh_destination) {
+bool AwoxMeshMqtt::publish_state(MeshDestination *mesh_destination) {
   if (!mesh_destination->can_publish_state()) {
     ESP_LOGW(TAG, "[%u] Can not yet send publish state for %s", mesh_destination->dest(), mesh_destination->type());
-    return;
+    return false;
   }
 
   if (this->last_published_state_.count(mesh_destination->dest()) &&
@@ -137,15 +236,14 @@ void AwoxMeshMqtt::publish_state(MeshDestination *mesh_destination) {
           0) {
     ESP_LOGV(TAG, "[%u] No need to update state is equal to last publication for %s", mesh_destination->dest(),
              mesh_destination->type());
-    return;
+    return false;
   }
 
-  this->last_published_state_[mesh_destination->dest()] = mesh_destination->state_as_char();
-
   ESP_LOGD(TAG, "Publish state for %s", mesh_destination->state_as_string().c_str());
 
+  bool published;
   if (mesh_destination->device_info->has_feature(FEATURE_LIGHT_MODE)) {
-    global_mqtt_client->publish_json(
+    published = global_mqtt_client->publish_json(
         this->get_mqtt_topic_for_(mesh_destination, "state"),
         [this, mesh_destination](JsonObject root) {
           root["state"] = mesh_destination->state ? "ON" : "OFF";
@@ -182,128 +280,515 @@ void AwoxMeshMqtt::publish_state(MeshDestination *mesh_destination) {
         },
         0, true);
   } else {
-    global_mqtt_client->publish(this->get_mqtt_topic_for_(mesh_destination, "state"),
-                                mesh_destination->state ? "ON" : "OFF", mesh_destination->state ? 2 : 3, 0, true);
+    published =
+        global_mqtt_client->publish(this->get_mqtt_topic_for_(mesh_destination, "state"),
+                                    mesh_destination->state ? "ON" : "OFF", mesh_destination->state ? 2 : 3, 0, true);
+  }
+
+  if (!published) {
+    return false;
+  }
+
+  this->last_published_state_[mesh_destination->dest()] = mesh_destination->state_as_char();
+  this->update_bulk_state_entry_(mesh_destination->dest());
+
+  if (this->binary_protocol_) {
+    this->publish_binary_state_(mesh_destination);
+  }
+
+  return true;
+}
+
+void AwoxMeshMqtt::queue_discovery_(DiscoveryPriority priority, const std::string &topic,
+                                    json::json_build_t &&build) {
+  std::deque<QueuedDiscovery> &queue = this->discovery_queue_[priority];
+
+  // Replace a not yet send message for the same topic
+  for (QueuedDiscovery &queued : queue) {
+    if (queued.topic == topic) {
+      queued.build = std::move(build);
+      queued.payload.clear();
+      queued.force |= this->force_discovery_;
+      return;
+    }
   }
+
+  QueuedDiscovery item{};
+  item.topic = topic;
+  item.build = std::move(build);
+  item.force = this->force_discovery_;
+  queue.push_back(std::move(item));
+  this->discovery_queued_++;
 }
 
-void AwoxMeshMqtt::publish_connection_sensor_discovery(const std::vector<MeshConnection *> &connections) {
+uint32_t AwoxMeshMqtt::discovery_hash_key_(const std::string &topic) const {
+  return fnv1_hash("awox_mesh_discovery_" + topic);
+}
+
+bool AwoxMeshMqtt::discovery_unchanged_(const std::string &topic, uint32_t hash) {
+  // Only retained discovery messages survive a Home Assistant or broker restart
+  if (!global_mqtt_client->get_discovery_info().retain) {
+    return false;
+  }
+
+  const uint32_t key = this->discovery_hash_key_(topic);
+  auto found = this->discovery_hashes_.find(key);
+  if (found == this->discovery_hashes_.end()) {
+    uint32_t stored_hash = 0;
+    ESPPreferenceObject preference = global_preferences->make_preference<uint32_t>(key, true);
+    if (!preference.load(&stored_hash)) {
+      stored_hash = 0;
+    }
+    found = this->discovery_hashes_.emplace(key, stored_hash).first;
+  }
+
+  return found->second == hash;
+}
+
+void AwoxMeshMqtt::store_discovery_hash_(const std::string &topic, uint32_t hash) {
+  if (!global_mqtt_client->get_discovery_info().retain) {
+    return;
+  }
+
+  const uint32_t key = this->discovery_hash_key_(topic);
+  auto found = this->discovery_hashes_.find(key);
+  if (found != this->discovery_hashes_.end() && found->second == hash) {
+    return;
+  }
+  this->discovery_hashes_[key] = hash;
+
+  ESPPreferenceObject preference = global_preferences->make_preference<uint32_t>(key, true);
+  preference.save(&hash);
+}
+
+size_t AwoxMeshMqtt::discovery_pending_() const {
+  size_t pending = 0;
+  for (const std::deque<QueuedDiscovery> &queue : this->discovery_queue_) {
+    pending += queue.size();
+  }
+  return pending;
+}
+
+void AwoxMeshMqtt::loop() {
+  if (!global_mqtt_client->is_connected()) {
+    return;
+  }
+
+  const uint32_t now = esphome::millis();
+
+  this->send_queued_discovery_(now);
+
+  // Has its own budget, so it continues while discovery messages are throttled
+  this->republish_next_(now);
+}
+
+void AwoxMeshMqtt::send_queued_discovery_(uint32_t now) {
+  for (std::deque<QueuedDiscovery> &queue : this->discovery_queue_) {
+    while (!queue.empty()) {
+      QueuedDiscovery &item = queue.front();
+      if (item.payload.empty()) {
+        item.payload = json::build_json(item.build);
+      }
+
+      const uint32_t hash = fnv1_hash(item.payload);
+      if (!item.force && this->discovery_unchanged_(item.topic, hash)) {
+        ESP_LOGV(TAG, "Skip discovery %s, unchanged since last publication", item.topic.c_str());
+        queue.pop_front();
+        this->discovery_skipped_++;
+        continue;
+      }
+
+      if (!this->discovery_message_limiter_.available(1, now) ||
+          !this->discovery_byte_limiter_.available(item.payload.size(), now)) {
+        // Lower priority messages have to wait for this one
+        return;
+      }
+      this->discovery_message_limiter_.consume(1);
+      this->discovery_byte_limiter_.consume(item.payload.size());
+
+      ESP_LOGV(TAG, "Send discovery %s (%d bytes)", item.topic.c_str(), item.payload.size());
+      global_mqtt_client->publish(item.topic, item.payload, 0, global_mqtt_client->get_discovery_info().retain);
+      this->store_discovery_hash_(item.topic, hash);
+      queue.pop_front();
+      this->discovery_sent_++;
+
+      if (this->discovery_pending_() == 0) {
+        ESP_LOGI(TAG, "All discovery messages send (%u send, %u unchanged)", this->discovery_sent_,
+                 this->discovery_skipped_);
+      }
+    }
+  }
+}
+
+void AwoxMeshMqtt::process_home_assistant_status_(const std::string &payload) {
+  if (payload != "online") {
+    return;
+  }
+
+  ESP_LOGI(TAG, "Home Assistant came online, republish discovery, state and availability");
+
+  // Not retained discovery messages are lost when Home Assistant restarts
+  if (!global_mqtt_client->get_discovery_info().retain) {
+    this->force_discovery_ = true;
+    this->mesh_->resend_discovery();
+    this->force_discovery_ = false;
+  }
+
+  if (this->published_connected) {
+    const std::string message = this->last_published_active_connections_ > 0 ? "online" : "offline";
+    global_mqtt_client->publish(global_mqtt_client->get_topic_prefix() + "/connected", message, 0, true);
+  }
+  // Force connection_status to be published with the next update
+  this->last_published_online_devices_ = -1;
+
+  this->republish_devices_.clear();
+  this->republish_groups_.clear();
+  this->mesh_->queue_republish();
+}
+
+void AwoxMeshMqtt::republish_next_(uint32_t now) {
+  if (this->republish_devices_.empty() && this->republish_groups_.empty()) {
+    return;
+  }
+
+  // Availability and, for online destinations, the state
+  while (!this->republish_devices_.empty() && this->republish_limiter_.try_consume(2, now)) {
+    Device *device = this->republish_devices_.front();
+    this->republish_devices_.pop_front();
+
+    this->last_published_state_.erase(device->dest());
+    this->last_published_availability_.erase(device->dest());
+    this->publish_availability(device);
+    if (device->online) {
+      this->publish_state(device);
+    }
+  }
+
+  while (this->republish_devices_.empty() && !this->republish_groups_.empty() &&
+         this->republish_limiter_.try_consume(2, now)) {
+    Group *group = this->republish_groups_.front();
+    this->republish_groups_.pop_front();
+
+    this->last_published_state_.erase(group->dest());
+    this->last_published_availability_.erase(group->dest());
+    this->publish_availability(group);
+    if (group->online) {
+      this->publish_state(group);
+    }
+  }
+
+  if (this->republish_devices_.empty() && this->republish_groups_.empty()) {
+    ESP_LOGI(TAG, "Republish after Home Assistant restart done");
+  }
+}
+
+void AwoxMeshMqtt::publish_binary_state_(MeshDestination *mesh_destination) {
+  uint8_t data[BINARY_STATE_SIZE];
+  encode_binary_state(mesh_destination->dest(), this->last_published_state_[mesh_destination->dest()], data);
+
+  global_mqtt_client->publish(global_mqtt_client->get_topic_prefix() + "/binary/state", (const char *) data,
+                              BINARY_STATE_SIZE, 0, false);
+}
+
+void AwoxMeshMqtt::process_incomming_binary_command(const std::string &payload) {
+  if (payload.empty() || payload.size() % BINARY_COMMAND_SIZE != 0) {
+    ESP_LOGW(TAG, "Invalid binary command, payload size %d is not a multiple of %d", payload.size(),
+             BINARY_COMMAND_SIZE);
+    return;
+  }
+
+  const uint8_t *data = (const uint8_t *) payload.data();
+  for (size_t offset = 0; offset < payload.size(); offset += BINARY_COMMAND_SIZE) {
+    MeshCommand command{};
+    if (!decode_binary_command(data + offset, &command)) {
+      ESP_LOGW(TAG, "[%u] Unknown binary command %02X", command.dest, command.op);
+      continue;
+    }
+
+    ESP_LOGD(TAG, "[%u] Process binary command %02X", command.dest, command.op);
+    this->mesh_->send_command(command);
+  }
+}
+
+void AwoxMeshMqtt::update_bulk_state_entry_(int dest) {
+  if (this->bulk_state_interval_ == 0) {
+    return;
+  }
+
+  // Entry: "<dest>":[availability,mode flags,white brightness,temperature,color brightness,R,G,B]
+  static const MeshDestinationState UNKNOWN_STATE = {};
+  const unsigned char *state =
+      this->last_published_state_.count(dest) ? this->last_published_state_[dest].state : UNKNOWN_STATE.state;
+  const bool available = this->last_published_availability_.count(dest) && this->last_published_availability_[dest];
+
+  char buffer[48];
+  int length = snprintf(buffer, sizeof(buffer), "\"%d\":[%d,%u,%u,%u,%u,%u,%u,%u]", dest, available ? 1 : 0, state[0],
+                        state[1], state[2], state[3], state[4], state[5], state[6]);
+
+  std::string &entry = this->bulk_state_entries_[dest];
+  if (entry.size() == (size_t) length && memcmp(entry.data(), buffer, length) == 0) {
+    return;
+  }
+
+  this->bulk_state_size_ = this->bulk_state_size_ - entry.size() + length;
+  entry.assign(buffer, length);
+  this->bulk_state_changed_ = true;
+}
+
+void AwoxMeshMqtt::publish_bulk_state() {
+  if (!this->bulk_state_changed_) {
+    return;
+  }
+  this->bulk_state_changed_ = false;
+
+  // Only changed entries are re-rendered, the document is a concatenation of the cached entries
+  std::string payload;
+  payload.reserve(this->bulk_state_size_ + this->bulk_state_entries_.size() + 2);
+  payload += '{';
+  for (auto &entry : this->bulk_state_entries_) {
+    if (payload.size() > 1) {
+      payload += ',';
+    }
+    payload += entry.second;
+  }
+  payload += '}';
+
+  ESP_LOGD(TAG, "Publish bulk state for %d destinations (%d bytes)", this->bulk_state_entries_.size(), payload.size());
+
+  global_mqtt_client->publish(global_mqtt_client->get_topic_prefix() + "/bulk_state", payload, 0, true);
+}
+
+void AwoxMeshMqtt::publish_statistics(const MeshStatistics &statistics,
+                                      const std::map<int, uint16_t> &availability_flaps, uint32_t free_heap) {
+  if (memcmp(&this->last_published_statistics_, &statistics, sizeof(MeshStatistics)) == 0 &&
+      this->last_published_discovery_sent_ == this->discovery_sent_ &&
+      this->last_published_discovery_queued_ == this->discovery_queued_ &&
+      this->last_published_discovery_skipped_ == this->discovery_skipped_) {
+    return;
+  }
+  this->last_published_statistics_ = statistics;
+  this->last_published_discovery_sent_ = this->discovery_sent_;
+  this->last_published_discovery_queued_ = this->discovery_queued_;
+  this->last_published_discovery_skipped_ = this->discovery_skipped_;
+
+  global_mqtt_client->publish_json(
+      global_mqtt_client->get_topic_prefix() + "/statistics",
+      [this, &statistics, &availability_flaps, free_heap](JsonObject root) {
+        root["state_publish_requests"] = statistics.state_publish_requests;
+        root["state_publish_sent"] = statistics.state_publish_sent;
+        root["state_publish_suppressed"] = statistics.state_publish_requests - statistics.state_publish_sent;
+        root["boot_to_first_attempt_ms"] = statistics.boot_to_first_attempt_ms;
+        root["boot_to_ready_ms"] = statistics.boot_to_ready_ms;
+        root["connection_heap_cost"] = statistics.connection_heap_cost;
+        root["low_duty_scan"] = statistics.low_duty_scan == 1;
+        root["scan_mode_changes"] = statistics.scan_mode_changes;
+        root["command_latency_full_scan_ms"] = statistics.command_latency_full_scan_ms;
+        root["command_latency_low_duty_scan_ms"] = statistics.command_latency_low_duty_scan_ms;
+        root["availability_flaps"] = statistics.availability_flaps;
+        root["liveness_probes"] = statistics.liveness_probes;
+        root["liveness_offline"] = statistics.liveness_offline;
+        JsonObject device_flaps = root["availability_flaps_per_device"].to<JsonObject>();
+        for (auto &flaps : availability_flaps) {
+          device_flaps[std::to_string(flaps.first)] = flaps.second;
+        }
+        root["free_heap"] = free_heap;
+        if (statistics.connection_heap_cost > 0) {
+          root["free_heap_connections"] = free_heap / statistics.connection_heap_cost;
+        }
+        root["discovery_queued"] = this->discovery_queued_;
+        root["discovery_sent"] = this->discovery_sent_;
+        root["discovery_unchanged"] = this->discovery_skipped_;
+        root["discovery_pending"] = this->discovery_pending_();
+      },
+      0, false);
+}
+
+void AwoxMeshMqtt::process_partition_announcement_(const std::string &topic, JsonObject root) {
+  const std::string hub_id = topic.substr(topic.rfind('/') + 1);
+
+  HubAnnouncement announcement{};
+  for (JsonPair reach : root["reach"].as<JsonObject>()) {
+    announcement.reach[atoi(reach.key().c_str())] = reach.value().as<int>();
+  }
+  for (JsonVariant mesh_id : root["claims"].as<JsonArray>()) {
+    announcement.claims.insert(mesh_id.as<int>());
+  }
+  ESP_LOGV(TAG, "Partition announcement of %s: reach %d, claims %d", hub_id.c_str(), announcement.reach.size(),
+           announcement.claims.size());
+
+  this->mesh_->process_partition_announcement(hub_id, std::move(announcement));
+}
+
+void AwoxMeshMqtt::publish_partition(const MeshPartition &partition) {
+  global_mqtt_client->publish_json(
+      this->partition_topic_ + "/" + partition.get_hub_id(),
+      [&partition](JsonObject root) {
+        JsonObject reach = root["reach"].to<JsonObject>();
+        for (auto &entry : partition.get_own_reach()) {
+          reach[std::to_string(entry.first)] = entry.second;
+        }
+        JsonArray claims = root["claims"].to<JsonArray>();
+        for (int mesh_id : partition.get_own_claims()) {
+          claims.add(mesh_id);
+        }
+      },
+      0, true);
+}
+
+void AwoxMeshMqtt::publish_heartbeat(int online_devices) {
+  global_mqtt_client->publish(global_mqtt_client->get_topic_prefix() + "/heartbeat", std::to_string(online_devices));
+}
+
+void AwoxMeshMqtt::publish_topology_chunk(int index, const TopologyChunk &chunk) {
+  global_mqtt_client->publish(global_mqtt_client->get_topic_prefix() + "/topology/" + std::to_string(index),
+                              (const char *) &chunk, sizeof(TopologyChunk), 0, true);
+}
+
+void AwoxMeshMqtt::announce_takeover() {
+  // Retained, so the primary points Home Assistant back to its own topics once it is back
+  global_mqtt_client->publish(this->standby_for_ + "/discovery/resend", "takeover by " + App.get_name(), 0, true);
+}
+
+void AwoxMeshMqtt::force_resend_discovery() {
+  this->discovery_hashes_.clear();
+  this->force_discovery_ = true;
+  this->mesh_->resend_discovery();
+  this->force_discovery_ = false;
+}
+
+void AwoxMeshMqtt::resend_discovery(Device *device) {
+  this->force_discovery_ = true;
+  this->mesh_->send_discovery(device);
+  this->force_discovery_ = false;
+
+  if (device->send_discovery) {
+    this->queue_republish(device);
+  }
+}
+
+void AwoxMeshMqtt::queue_connection_sensor_discovery_(int index, const std::string &component, const std::string &id,
+                                                      const std::string &name, const char *icon,
+                                                      const std::string &value) {
   const MQTTDiscoveryInfo &discovery_info = global_mqtt_client->get_discovery_info();
-  const std::string sanitized_name = str_sanitize(App.get_name());
+  const std::string object_id = "connection-" + std::to_string(index) + "-" + id;
+
+  this->queue_discovery_(
+      DISCOVERY_PRIORITY_DIAGNOSTIC,
+      discovery_info.prefix + "/" + component + "/" + str_sanitize(App.get_name()) + "/" + object_id + "/config",
+      [this, index, component, object_id, name, icon, value](JsonObject root) {
+        const DiscoveryKeys &keys = this->discovery_keys_();
+        this->add_discovery_base_topic_(root);
+
+        // Entity
+        root[keys.name] = "Connection " + std::to_string(index) + " " + name;
+        root[keys.unique_id] = "awox-" + object_id;
+        root[keys.entity_category] = "diagnostic";
+        root[keys.icon] = icon;
+
+        // State topic
+        root[keys.state_topic] = this->get_discovery_topic_value_("connection_status");
+        root[keys.availability_topic] = this->get_discovery_topic_value_("status");
+        root[keys.value_template] = "{{ value_json.connection_" + std::to_string(index) + "." + value + " }}";
+
+        if (component == "binary_sensor") {
+          root[keys.payload_on] = true;
+          root[keys.payload_off] = false;
+        } else {
+          root[keys.enabled_by_default] = false;
+        }
+
+        // Device
+        JsonObject device_info = root[keys.device].to<JsonObject>();
+        device_info[keys.device_identifiers] = get_mac_address();
+      });
+}
 
+void AwoxMeshMqtt::publish_connection_sensor_discovery(const std::vector<MeshConnection *> &connections) {
   for (int i = 0; i < connections.size(); i++) {
-    global_mqtt_client->publish_json(
-        discovery_info.prefix + "/sensor/" + sanitized_name + "/connection-" + std::to_string(i) + "-devices/config",
-        [this, i, discovery_info](JsonObject root) {
-          // Entity
-          root[MQTT_NAME] = "Connection " + std::to_string(i) + " devices";
-          root[MQTT_UNIQUE_ID] = "awox-connection-" + std::to_string(i) + "-devices";
-          root[MQTT_ENTITY_CATEGORY] = "diagnostic";
-          root[MQTT_ICON] = "mdi:counter";
-          root[MQTT_ENABLED_BY_DEFAULT] = false;
-
-          // State and command topic
-          root[MQTT_STATE_TOPIC] = global_mqtt_client->get_topic_prefix() + "/connection_status";
-
-          root[MQTT_AVAILABILITY_TOPIC] = global_mqtt_client->get_topic_prefix() + "/status";
-          root[MQTT_VALUE_TEMPLATE] = "{{ value_json.connection_" + std::to_string(i) + ".devices }}";
-
-          // Device
-          JsonObject device_info = root[MQTT_DEVICE].to<JsonObject>();
-          device_info[MQTT_DEVICE_IDENTIFIERS] = get_mac_address();
-        },
-        0, discovery_info.retain);
-
-    global_mqtt_client->publish_json(
-        discovery_info.prefix + "/sensor/" + sanitized_name + "/connection-" + std::to_string(i) + "-mesh-ids/config",
-        [this, i, discovery_info](JsonObject root) {
-          // Entity
-          root[MQTT_NAME] = "Connection " + std::to_string(i) + " Mesh ID's";
-          root[MQTT_UNIQUE_ID] = "awox-connection-" + std::to_string(i) + "-mesh-ids";
-          root[MQTT_ENTITY_CATEGORY] = "diagnostic";
-          root[MQTT_ICON] = "mdi:vector-polyline";
-          root[MQTT_ENABLED_BY_DEFAULT] = false;
-
-          // State and command topic
-          root[MQTT_STATE_TOPIC] = global_mqtt_client->get_topic_prefix() + "/connection_status";
-
-          root[MQTT_AVAILABILITY_TOPIC] = global_mqtt_client->get_topic_prefix() + "/status";
-          root[MQTT_VALUE_TEMPLATE] = "{{ value_json.connection_" + std::to_string(i) + ".mesh_ids }}";
-
-          // Device
-          JsonObject device_info = root[MQTT_DEVICE].to<JsonObject>();
-          device_info[MQTT_DEVICE_IDENTIFIERS] = get_mac_address();
-        },
-        0, discovery_info.retain);
-
-    global_mqtt_client->publish_json(
-        discovery_info.prefix + "/sensor/" + sanitized_name + "/connection-" + std::to_string(i) + "-mesh-id/config",
-        [this, i, discovery_info](JsonObject root) {
-          // Entity
-          root[MQTT_NAME] = "Connection " + std::to_string(i) + " Mesh ID";
-          root[MQTT_UNIQUE_ID] = "awox-connection-" + std::to_string(i) + "-mesh-id";
-          root[MQTT_ENTITY_CATEGORY] = "diagnostic";
-          root[MQTT_ICON] = "mdi:vector-point-select";
-          root[MQTT_ENABLED_BY_DEFAULT] = false;
-
-          // State and command topic
-          root[MQTT_STATE_TOPIC] = global_mqtt_client->get_topic_prefix() + "/connection_status";
-
-          root[MQTT_AVAILABILITY_TOPIC] = global_mqtt_client->get_topic_prefix() + "/status";
-          root[MQTT_VALUE_TEMPLATE] = "{{ value_json.connection_" + std::to_string(i) + ".mesh_id }}";
-
-          // Device
-          JsonObject device_info = root[MQTT_DEVICE].to<JsonObject>();
-          device_info[MQTT_DEVICE_IDENTIFIERS] = get_mac_address();
-        },
-        0, discovery_info.retain);
-
-    global_mqtt_client->publish_json(
-        discovery_info.prefix + "/sensor/" + sanitized_name + "/connection-" + std::to_string(i) + "-mac/config",
-        [this, i, discovery_info](JsonObject root) {
-          // Entity
-          root[MQTT_NAME] = "Connection " + std::to_string(i) + " mac address";
-          root[MQTT_UNIQUE_ID] = "awox-connection-" + std::to_string(i) + "-mac";
-          root[MQTT_ENTITY_CATEGORY] = "diagnostic";
-          root[MQTT_ICON] = "mdi:information";
-          root[MQTT_ENABLED_BY_DEFAULT] = false;
-
-          // State and command topic
-          root[MQTT_STATE_TOPIC] = global_mqtt_client->get_topic_prefix() + "/connection_status";
-
-          root[MQTT_AVAILABILITY_TOPIC] = global_mqtt_client->get_topic_prefix() + "/status";
-          root[MQTT_VALUE_TEMPLATE] = "{{ value_json.connection_" + std::to_string(i) + ".mac }}";
-
-          // Device
-          JsonObject device_info = root[MQTT_DEVICE].to<JsonObject>();
-          device_info[MQTT_DEVICE_IDENTIFIERS] = get_mac_address();
-        },
-        0, discovery_info.retain);
-
-    global_mqtt_client->publish_json(
-        discovery_info.prefix + "/binary_sensor/" + sanitized_name + "/connection-" + std::to_string(i) +
-            "-connected/config",
-        [this, i, discovery_info](JsonObject root) {
-          // Entity
-          root[MQTT_NAME] = "Connection " + std::to_string(i) + " connected";
-          root[MQTT_UNIQUE_ID] = "awox-connection-" + std::to_string(i) + "-connected";
-          root[MQTT_ENTITY_CATEGORY] = "diagnostic";
-          root[MQTT_ICON] = "mdi:connection";
-
-          root[MQTT_AVAILABILITY_TOPIC] = global_mqtt_client->get_topic_prefix() + "/status";
-
-          // State and command topic
-          root[MQTT_STATE_TOPIC] = global_mqtt_client->get_topic_prefix() + "/connection_status";
-
-          root[MQTT_PAYLOAD_ON] = true;
-          root[MQTT_PAYLOAD_OFF] = false;
-          root[MQTT_VALUE_TEMPLATE] = "{{ value_json.connection_" + std::to_string(i) + ".connected }}";
-
-          // Device
-          JsonObject device_info = root[MQTT_DEVICE].to<JsonObject>();
-          device_info[MQTT_DEVICE_IDENTIFIERS] = get_mac_address();
-        },
-        0, discovery_info.retain);
+    this->queue_connection_sensor_discovery_(i, "sensor", "devices", "devices", "mdi:counter", "devices");
+    this->queue_connection_sensor_discovery_(i, "sensor", "mesh-ids", "Mesh ID's", "mdi:vector-polyline", "mesh_ids");
+    this->queue_connection_sensor_discovery_(i, "sensor", "mesh-id", "Mesh ID", "mdi:vector-point-select", "mesh_id");
+    this->queue_connection_sensor_discovery_(i, "sensor", "mac", "mac address", "mdi:information", "mac");
+    this->queue_connection_sensor_discovery_(i, "binary_sensor", "connected", "connected", "mdi:connection",
+                                             "connected");
+  }
+}
+
+const DiscoveryKeys &AwoxMeshMqtt::discovery_keys_() const {
+  return this->discovery_abbreviations_ ? DISCOVERY_KEYS_ABBREVIATED : DISCOVERY_KEYS;
+}
+
+std::string AwoxMeshMqtt::get_discovery_topic_value_(const std::string &suffix) const {
+  if (this->discovery_abbreviations_) {
+    return "~/" + suffix;
+  }
+  return global_mqtt_client->get_topic_prefix() + "/" + suffix;
+}
+
+void AwoxMeshMqtt::add_discovery_base_topic_(JsonObject root) const {
+  if (this->discovery_abbreviations_) {
+    root["~"] = global_mqtt_client->get_topic_prefix();
+  }
+}
+
+void AwoxMeshMqtt::build_light_discovery_(JsonObject root, MeshDestination *mesh_destination) const {
+  const DiscoveryKeys &keys = this->discovery_keys_();
+  const std::string dest = std::to_string(mesh_destination->dest());
+  DeviceInfo *device_info = mesh_destination->device_info;
+
+  this->add_discovery_base_topic_(root);
+  root[keys.schema] = "json";
+
+  // Entity
+  root[keys.name] = nullptr;
+
+  // State and command topic
+  root[keys.state_topic] = this->get_discovery_topic_value_(dest + "/state");
+  root[keys.command_topic] = this->get_discovery_topic_value_(dest + "/command");
+
+  // Availavility topics
+  JsonArray availability = root[keys.availability].to<JsonArray>();
+  auto availability_topic_1 = availability.add<JsonObject>();
+  availability_topic_1[keys.topic] = this->get_discovery_topic_value_(dest + "/availability");
+  auto availability_topic_2 = availability.add<JsonObject>();
+  availability_topic_2[keys.topic] = this->get_discovery_topic_value_("status");
+  auto availability_topic_3 = availability.add<JsonObject>();
+  availability_topic_3[keys.topic] = this->get_discovery_topic_value_("connected");
+  root[keys.availability_mode] = "all";
+
+  // Features
+  if (device_info->has_feature(FEATURE_WHITE_BRIGHTNESS) || device_info->has_feature(FEATURE_COLOR_BRIGHTNESS)) {
+    root[keys.brightness] = true;
+    root[keys.brightness_scale] = 255;
+  }
+
+  JsonArray color_modes = root[keys.supported_color_modes].to<JsonArray>();
+
+  if (device_info->has_feature(FEATURE_COLOR)) {
+    color_modes.add("rgb");
+
+    root[keys.effect] = true;
+    JsonArray effect_list = root[keys.effect_list].to<JsonArray>();
+    effect_list.add("candle");
+    effect_list.add("color loop");
+    effect_list.add("stop");
+  }
+
+  if (device_info->has_feature(FEATURE_WHITE_TEMPERATURE)) {
+    color_modes.add("color_temp");
+
+    root[keys.min_mireds] = 153;
+    root[keys.max_mireds] = 370;
+  }
+
+  // brightness should always be used alone
+  // https://developers.home-assistant.io/docs/core/entity/light/#color-modes
+  if (color_modes.size() == 0 && device_info->has_feature(FEATURE_WHITE_BRIGHTNESS)) {
+    color_modes.add("brightness");
+  }
+
+  if (color_modes.size() == 0) {
+    color_modes.add("onoff");
   }
 }
 
@@ -320,90 +805,41 @@ void AwoxMeshMqtt::send_discovery(Device *device) {
 
   const MQTTDiscoveryInfo &discovery_info = global_mqtt_client->get_discovery_info();
 
-  global_mqtt_client->publish_json(
-      this->get_discovery_topic_(discovery_info, device),
-      [this, device, discovery_info](JsonObject root) {
-        root["schema"] = "json";
+  this->queue_discovery_(
+      DISCOVERY_PRIORITY_DEVICE, this->get_discovery_topic_(discovery_info, device),
+      [this, device](JsonObject root) {
+        const DiscoveryKeys &keys = this->discovery_keys_();
+        this->build_light_discovery_(root, device);
 
         // Entity
-        root[MQTT_NAME] = nullptr;
-        root[MQTT_UNIQUE_ID] = "awox-" + device->address_str() + "-" + device->device_info->get_component_type();
+        root[keys.unique_id] = "awox-" + device->address_str() + "-" + device->device_info->get_component_type();
 
         if (strlen(device->device_info->get_icon()) > 0) {
-          root[MQTT_ICON] = device->device_info->get_icon();
-        }
-
-        // State and command topic
-        root[MQTT_STATE_TOPIC] = this->get_mqtt_topic_for_(device, "state");
-        root[MQTT_COMMAND_TOPIC] = this->get_mqtt_topic_for_(device, "command");
-
-        // Availavility topics
-        JsonArray availability = root[MQTT_AVAILABILITY].to<JsonArray>();
-        auto availability_topic_1 = availability.add<JsonObject>();
-        availability_topic_1[MQTT_TOPIC] = this->get_mqtt_topic_for_(device, "availability");
-        auto availability_topic_2 = availability.add<JsonObject>();
-        availability_topic_2[MQTT_TOPIC] = global_mqtt_client->get_topic_prefix() + "/status";
-        auto availability_topic_3 = availability.add<JsonObject>();
-        availability_topic_3[MQTT_TOPIC] = global_mqtt_client->get_topic_prefix() + "/connected";
-        root[MQTT_AVAILABILITY_MODE] = "all";
-
-        // Features
-        if (device->device_info->has_feature(FEATURE_WHITE_BRIGHTNESS) ||
-            device->device_info->has_feature(FEATURE_COLOR_BRIGHTNESS)) {
-          root["brightness"] = true;
-          root["brightness_scale"] = 255;
-        }
-
-        JsonArray color_modes = root["supported_color_modes"].to<JsonArray>();
-
-        if (device->device_info->has_feature(FEATURE_COLOR)) {
-          color_modes.add("rgb");
-
-          root["effect"] = true;
-          JsonArray effect_list = root[MQTT_EFFECT_LIST].to<JsonArray>();
-          effect_list.add("candle");
-          effect_list.add("color loop");
-          effect_list.add("stop");
-        }
-
-        if (device->device_info->has_feature(FEATURE_WHITE_TEMPERATURE)) {
-          color_modes.add("color_temp");
-
-          root[MQTT_MIN_MIREDS] = 153;
-          root[MQTT_MAX_MIREDS] = 370;
-        }
-
-        // brightness should always be used alone
-        // https://developers.home-assistant.io/docs/core/entity/light/#color-modes
-        if (color_modes.size() == 0 && device->device_info->has_feature(FEATURE_WHITE_BRIGHTNESS)) {
-          color_modes.add("brightness");
-        }
-
-        if (color_modes.size() == 0) {
-          color_modes.add("onoff");
+          root[keys.icon] = device->device_info->get_icon();
         }
 
         // Device
-        JsonObject device_info = root[MQTT_DEVICE].to<JsonObject>();
+        JsonObject device_info = root[keys.device].to<JsonObject>();
 
-        JsonArray identifiers = device_info[MQTT_DEVICE_IDENTIFIERS].to<JsonArray>();
+        JsonArray identifiers = device_info[keys.device_identifiers].to<JsonArray>();
         identifiers.add("esp-awox-mesh-" + std::to_string(device->mesh_id));
         identifiers.add(device->address_str());
 
-        device_info[MQTT_DEVICE_NAME] = device->device_info->get_name();
+        device_info[keys.device_name] = device->device_info->get_name();
 
         if (strlen(device->device_info->get_model()) == 0) {
-          device_info[MQTT_DEVICE_MODEL] = get_product_code_as_hex_string(device->device_info->get_product_id());
+          device_info[keys.device_model] = get_product_code_as_hex_string(device->device_info->get_product_id());
         } else {
-          device_info[MQTT_DEVICE_MODEL] = std::string(device->device_info->get_model());
+          device_info[keys.device_model] = std::string(device->device_info->get_model());
         }
-        device_info[MQTT_DEVICE_MANUFACTURER] = device->device_info->get_manufacturer();
-        device_info["via_device"] = get_mac_address();
-        device_info["serial_number"] = "mesh-id " + std::to_string(device->mesh_id);
-      },
-      0, discovery_info.retain);
+        device_info[keys.device_manufacturer] = device->device_info->get_manufacturer();
+        device_info[keys.device_via_device] = get_mac_address();
+        device_info[keys.device_serial_number] = "mesh-id " + std::to_string(device->mesh_id);
+      });
 
-  if (device->device_info->has_feature(FEATURE_LIGHT_MODE)) {
+  if (!this->command_subscriptions_.insert(device->dest()).second) {
+    ESP_LOGV(TAG, "[%u] Already subscribed to command topic", device->dest());
+  } else if (device->device_info->has_feature(FEATURE_LIGHT_MODE)) {
     global_mqtt_client->subscribe_json(
         this->get_mqtt_topic_for_(device, "command"),
         [this, device](const std::string &topic, JsonObject root) { this->process_incomming_command(device, root); });
@@ -442,84 +878,36 @@ void AwoxMeshMqtt::send_group_discovery(Group *group) {
 
   const MQTTDiscoveryInfo &discovery_info = global_mqtt_client->get_discovery_info();
 
-  global_mqtt_client->publish_json(
+  this->queue_discovery_(
+      DISCOVERY_PRIORITY_GROUP,
       discovery_info.prefix + "/" + group->device_info->get_component_type() + "/group-" +
           std::to_string(group->group_id) + "/config",
-      [this, group, discovery_info](JsonObject root) {
-        root["schema"] = "json";
-        // Entity
-        root[MQTT_NAME] = nullptr;
-        root[MQTT_UNIQUE_ID] = "group-" + std::to_string(group->group_id);
-
-        root[MQTT_ICON] = "mdi:lightbulb-group";
-
-        // State and command topic
-        root[MQTT_STATE_TOPIC] = this->get_mqtt_topic_for_(group, "state");
-        root[MQTT_COMMAND_TOPIC] = this->get_mqtt_topic_for_(group, "command");
-
-        // Availavility topics
-        JsonArray availability = root[MQTT_AVAILABILITY].to<JsonArray>();
-        auto availability_topic_1 = availability.add<JsonObject>();
-        availability_topic_1[MQTT_TOPIC] = this->get_mqtt_topic_for_(group, "availability");
-        auto availability_topic_2 = availability.add<JsonObject>();
-        availability_topic_2[MQTT_TOPIC] = global_mqtt_client->get_topic_prefix() + "/status";
-        auto availability_topic_3 = availability.add<JsonObject>();
-        availability_topic_3[MQTT_TOPIC] = global_mqtt_client->get_topic_prefix() + "/connected";
-        root[MQTT_AVAILABILITY_MODE] = "all";
-
-        // Features
-        if (group->device_info->has_feature(FEATURE_WHITE_BRIGHTNESS) ||
-            group->device_info->has_feature(FEATURE_COLOR_BRIGHTNESS)) {
-          root["brightness"] = true;
-          root["brightness_scale"] = 255;
-        }
-
-        JsonArray color_modes = root["supported_color_modes"].to<JsonArray>();
+      [this, group](JsonObject root) {
+        const DiscoveryKeys &keys = this->discovery_keys_();
+        this->build_light_discovery_(root, group);
 
-        if (group->device_info->has_feature(FEATURE_COLOR)) {
-          color_modes.add("rgb");
-
-          root["effect"] = true;
-          JsonArray effect_list = root[MQTT_EFFECT_LIST].to<JsonArray>();
-          effect_list.add("candle");
-          effect_list.add("color loop");
-          effect_list.add("stop");
-        }
-
-        if (group->device_info->has_feature(FEATURE_WHITE_TEMPERATURE)) {
-          color_modes.add("color_temp");
-
-          root[MQTT_MIN_MIREDS] = 153;
-          root[MQTT_MAX_MIREDS] = 370;
-        }
-
-        // brightness should always be used alone
-        // https://developers.home-assistant.io/docs/core/entity/light/#color-modes
-        if (color_modes.size() == 0 && group->device_info->has_feature(FEATURE_WHITE_BRIGHTNESS)) {
-          color_modes.add("brightness");
-        }
-
-        if (color_modes.size() == 0) {
-          color_modes.add("onoff");
-        }
+        // Entity
+        root[keys.unique_id] = "group-" + std::to_string(group->group_id);
+        root[keys.icon] = "mdi:lightbulb-group";
 
         // Device
-        JsonObject device_info = root[MQTT_DEVICE].to<JsonObject>();
+        JsonObject device_info = root[keys.device].to<JsonObject>();
 
-        JsonArray identifiers = device_info[MQTT_DEVICE_IDENTIFIERS].to<JsonArray>();
+        JsonArray identifiers = device_info[keys.device_identifiers].to<JsonArray>();
         identifiers.add("esp-awox-mesh-group-" + std::to_string(group->group_id));
 
-        device_info[MQTT_DEVICE_MODEL] = "Group - " + std::to_string(group->group_id);
-        device_info[MQTT_DEVICE_MANUFACTURER] = "ESPHome AwoX BLE mesh";
+        device_info[keys.device_model] = "Group - " + std::to_string(group->group_id);
+        device_info[keys.device_manufacturer] = "ESPHome AwoX BLE mesh";
 
-        device_info[MQTT_DEVICE_NAME] = "Group " + std::to_string(group->group_id);
+        device_info[keys.device_name] = "Group " + std::to_string(group->group_id);
 
-        device_info["via_device"] = get_mac_address();
-        device_info["serial_number"] = "group-id " + std::to_string(group->group_id);
-      },
-      0, discovery_info.retain);
+        device_info[keys.device_via_device] = get_mac_address();
+        device_info[keys.device_serial_number] = "group-id " + std::to_string(group->group_id);
+      });
 
-  if (group->device_info->has_feature(FEATURE_LIGHT_MODE)) {
+  if (!this->command_subscriptions_.insert(group->dest()).second) {
+    ESP_LOGV(TAG, "[%u] Already subscribed to command topic", group->dest());
+  } else if (group->device_info->has_feature(FEATURE_LIGHT_MODE)) {
     global_mqtt_client->subscribe_json(
         this->get_mqtt_topic_for_(group, "command"),
         [this, group](const std::string &topic, JsonObject root) { this->process_incomming_command(group, root); });
@@ -530,114 +918,24 @@ void AwoxMeshMqtt::send_group_discovery(Group *group) {
 }
 
 void AwoxMeshMqtt::process_incomming_command(MeshDestination *mesh_destination, JsonObject root) {
-  int dest = mesh_destination->dest();
-  bool state_set = false;
-
-  ESP_LOGI(TAG, "[%u] Process command %s", dest, mesh_destination->type());
-
-  if (root["fade_duration"].is<JsonVariant>()) {
-    ESP_LOGD(TAG, "[%u] set sequence fade_duration %d", dest, (int) root["fade_duration"]);
-    this->mesh_->set_sequence_fade_duration(dest, (int) root["fade_duration"]);
-  }
-
-  if (root["color_duration"].is<JsonVariant>()) {
-    ESP_LOGD(TAG, "[%u] set sequence color_duration %d", dest, (int) root["color_duration"]);
-    this->mesh_->set_sequence_color_duration(dest, (int) root["color_duration"]);
-  }
-
-  if (root["color"].is<JsonVariant>()) {
-    JsonObject color = root["color"];
-
-    state_set = true;
-    mesh_destination->state = true;
-    mesh_destination->color_mode = true;
-    mesh_destination->R = (int) color["r"];
-    mesh_destination->G = (int) color["g"];
-    mesh_destination->B = (int) color["b"];
+  ESP_LOGI(TAG, "[%u] Process command %s", mesh_destination->dest(), mesh_destination->type());
 
-    ESP_LOGD(TAG, "[%u] Process command color %d %d %d", dest, (int) color["r"], (int) color["g"], (int) color["b"]);
+  LightCommand command{};
+  decode_light_command(root, &command);
 
-    this->mesh_->set_color(dest, (int) color["r"], (int) color["g"], (int) color["b"]);
-  }
-
-  if (root["brightness"].is<JsonVariant>() && !root["color_temp"].is<JsonVariant>() &&
-      (root["color"].is<JsonVariant>() || mesh_destination->color_mode)) {
-    int brightness = convert_value_to_available_range((int) root["brightness"], 0, 255, 0xa, 0x64);
-
-    state_set = true;
-    mesh_destination->state = true;
-    mesh_destination->color_brightness = brightness;
-
-    ESP_LOGD(TAG, "[%u] Process command color_brightness %d", dest, (int) root["brightness"]);
-    this->mesh_->set_color_brightness(dest, brightness);
-
-  } else if (root["brightness"].is<JsonVariant>()) {
-    int brightness = convert_value_to_available_range((int) root["brightness"], 0, 255, 1, 0x7f);
+  MeshCommandPlan plan{};
+  plan_light_command(command, mesh_destination, &plan);
 
-    state_set = true;
-    mesh_destination->state = true;
-    mesh_destination->white_brightness = brightness;
-
-    ESP_LOGD(TAG, "[%u] Process command white_brightness %d", dest, (int) root["brightness"]);
-    this->mesh_->set_white_brightness(dest, brightness);
+  for (uint8_t i = 0; i < plan.size; i++) {
+    const MeshCommand &mesh_command = plan.commands[i];
+    ESP_LOGD(TAG, "[%u] Planned command %02X (%d %d %d)", mesh_command.dest, mesh_command.op, mesh_command.value[0],
+             mesh_command.value[1], mesh_command.value[2]);
   }
 
-  if (root["color_temp"].is<JsonVariant>()) {
-    int temperature = convert_value_to_available_range((int) root["color_temp"], 153, 370, 0, 0x7f);
-
-    state_set = true;
-    mesh_destination->state = true;
-    mesh_destination->color_mode = false;
-    mesh_destination->temperature = temperature;
-
-    ESP_LOGD(TAG, "[%u] Process command color_temp %d", dest, (int) root["color_temp"]);
-    this->mesh_->set_white_temperature(dest, temperature);
-  }
-
-  if (root["effect"].is<JsonVariant>()) {
-    state_set = true;
-    mesh_destination->state = true;
-    mesh_destination->sequence_mode = false;
-    mesh_destination->candle_mode = false;
-    if (root["effect"] == "color loop") {
-      mesh_destination->sequence_mode = true;
-      this->mesh_->set_sequence(dest, 0);
-    } else if (root["effect"] == "candle") {
-      mesh_destination->candle_mode = true;
-      this->mesh_->set_candle_mode(dest);
-    } else {
-      if (mesh_destination->color_mode) {
-        this->mesh_->set_color(dest, mesh_destination->R, mesh_destination->G, mesh_destination->B);
-      } else {
-        this->mesh_->set_white_temperature(dest, mesh_destination->temperature);
-      }
-    }
-  }
-
-  if (root["state"].is<JsonVariant>()) {
-    ESP_LOGD(TAG, "[%u] Process command state", dest);
-    auto val = parse_on_off(root["state"]);
-    switch (val) {
-      case PARSE_ON:
-        mesh_destination->state = true;
-        if (!state_set) {
-          this->mesh_->set_power(dest, true);
-        }
-        break;
-      case PARSE_OFF:
-        mesh_destination->state = false;
-        this->mesh_->set_power(dest, false);
-        break;
-      case PARSE_TOGGLE:
-        mesh_destination->state = !mesh_destination->state;
-        this->mesh_->set_power(dest, mesh_destination->state);
-        break;
-      case PARSE_NONE:
-        break;
-    }
-  }
+  // All mesh commands of 1 Home Assistant command are send as 1 burst
+  this->mesh_->send_commands(plan.commands, plan.size);
 
-  this->publish_state(mesh_destination);
+  this->mesh_->publish_state(mesh_destination);
 }
 
 }  // namespace awox_mesh
@@ -2,19 +2,61 @@
 
 #ifdef USE_ESP32
 
+#include <deque>
 #include <map>
+#include <set>
 #include <vector>
 
+#include "esphome/components/json/json_util.h"
+
 #include "mesh_destination.h"
 #include "mesh_connection.h"
+#include "mesh_partition.h"
 #include "device.h"
+#include "discovery_keys.h"
 #include "group.h"
+#include "rate_limiter.h"
+#include "statistics.h"
+#include "topology_cache.h"
 
 namespace esphome {
 namespace awox_mesh {
 
 class AwoxMesh;
 
+/** Maximum number of state and availability messages per second while republishing after a Home Assistant restart */
+#define REPUBLISH_MESSAGES_PER_SECOND 20
+
+/** Discovery messages are send in order of priority */
+enum DiscoveryPriority {
+  DISCOVERY_PRIORITY_DEVICE = 0,
+  DISCOVERY_PRIORITY_GROUP,
+  DISCOVERY_PRIORITY_DIAGNOSTIC,
+  DISCOVERY_PRIORITY_COUNT,
+};
+
+/** Home Assistant limits a sensor state to 255 characters */
+#define CONNECTION_STATUS_MESH_IDS_SIZE 256
+
+/** Last rendered connection_status fields of 1 connection */
+struct ConnectionStatus {
+  bool connected = false;
+  int mesh_id = 0;
+  uint32_t linked_mesh_ids_version = 0;
+  size_t devices = 0;
+  std::string mac;
+  char mesh_ids[CONNECTION_STATUS_MESH_IDS_SIZE] = {};
+};
+
+struct QueuedDiscovery {
+  std::string topic;
+  json::json_build_t build;
+  /** Rendered on first send attempt, kept when the budget doesn't allow sending yet */
+  std::string payload;
+  /** Send even when the payload is unchanged since the last publication */
+  bool force;
+};
+
 class AwoxMeshMqtt {
   AwoxMesh *mesh_;
 
@@ -24,6 +66,44 @@ class AwoxMeshMqtt {
   std::map<int, bool> last_published_availability_;
   int last_published_active_connections_;
   int last_published_online_devices_;
+  std::vector<ConnectionStatus> connection_status_;
+  MeshStatistics last_published_statistics_{};
+  uint32_t last_published_discovery_queued_ = 0;
+  uint32_t last_published_discovery_sent_ = 0;
+  uint32_t last_published_discovery_skipped_ = 0;
+
+  bool binary_protocol_ = false;
+
+  uint32_t bulk_state_interval_ = 0;
+  bool bulk_state_changed_ = false;
+  size_t bulk_state_size_ = 0;
+  std::map<int, std::string> bulk_state_entries_;
+
+  std::deque<QueuedDiscovery> discovery_queue_[DISCOVERY_PRIORITY_COUNT];
+  RateLimiter discovery_message_limiter_;
+  RateLimiter discovery_byte_limiter_;
+  uint32_t discovery_queued_ = 0;
+  uint32_t discovery_sent_ = 0;
+  uint32_t discovery_skipped_ = 0;
+  bool force_discovery_ = false;
+  /** Hash of the last published discovery payload per topic, persisted in flash */
+  std::map<uint32_t, uint32_t> discovery_hashes_;
+
+  /** Use abbreviated discovery keys and `~` as base topic */
+  bool discovery_abbreviations_ = false;
+
+  std::set<int> command_subscriptions_;
+
+  /** Destinations waiting to be republished after Home Assistant came online */
+  std::deque<Device *> republish_devices_;
+  std::deque<Group *> republish_groups_;
+  RateLimiter republish_limiter_;
+
+  /** Retained announcements of all hubs sharing the mesh are published below this topic, empty when not used */
+  std::string partition_topic_;
+
+  /** Topic prefix of the primary hub when this hub is its hot standby */
+  std::string standby_for_;
 
   std::string get_mqtt_topic_for_(MeshDestination *mesh_destination, const std::string &suffix) const;
 
@@ -31,18 +111,92 @@ class AwoxMeshMqtt {
 
   void process_incomming_command(MeshDestination *mesh_destination, JsonObject root);
 
+  bool update_connection_status_(ConnectionStatus &status, MeshConnection *connection);
+
+  void update_bulk_state_entry_(int dest);
+
+  void process_incomming_binary_command(const std::string &payload);
+
+  void publish_binary_state_(MeshDestination *mesh_destination);
+
+  void queue_discovery_(DiscoveryPriority priority, const std::string &topic, json::json_build_t &&build);
+
+  size_t discovery_pending_() const;
+
+  void send_queued_discovery_(uint32_t now);
+
+  uint32_t discovery_hash_key_(const std::string &topic) const;
+
+  bool discovery_unchanged_(const std::string &topic, uint32_t hash);
+
+  void store_discovery_hash_(const std::string &topic, uint32_t hash);
+
+  const DiscoveryKeys &discovery_keys_() const;
+
+  std::string get_discovery_topic_value_(const std::string &suffix) const;
+
+  void add_discovery_base_topic_(JsonObject root) const;
+
+  void build_light_discovery_(JsonObject root, MeshDestination *mesh_destination) const;
+
+  void process_home_assistant_status_(const std::string &payload);
+
+  void republish_next_(uint32_t now);
+
+  void process_partition_announcement_(const std::string &topic, JsonObject root);
+
+  void queue_connection_sensor_discovery_(int index, const std::string &component, const std::string &id,
+                                          const std::string &name, const char *icon, const std::string &value);
+
  public:
-  AwoxMeshMqtt(AwoxMesh *mesh) { this->mesh_ = mesh; }
+  AwoxMeshMqtt(AwoxMesh *mesh) {
+    this->mesh_ = mesh;
+    this->republish_limiter_.set_rate(REPUBLISH_MESSAGES_PER_SECOND);
+  }
 
   void setup();
 
+  void loop();
+
   void publish_availability(Device *device);
   void publish_availability(Group *group);
+  /** Availability of the device last published is `online` */
+  bool availability_published(Device *device, bool online) const {
+    auto published = this->last_published_availability_.find(device->dest());
+    return published != this->last_published_availability_.end() && published->second == online;
+  }
   void send_discovery(Device *device);
   void send_group_discovery(Group *group);
   void publish_connection_sensor_discovery(const std::vector<MeshConnection *> &connections);
   void publish_connected(int active_connections, int online_devices, const std::vector<MeshConnection *> &connections);
-  void publish_state(MeshDestination *mesh_destination);
+  bool publish_state(MeshDestination *mesh_destination);
+  void publish_statistics(const MeshStatistics &statistics, const std::map<int, uint16_t> &availability_flaps,
+                          uint32_t free_heap);
+  void queue_republish(Device *device) { this->republish_devices_.push_back(device); }
+  void queue_republish(Group *group) { this->republish_groups_.push_back(group); }
+  void resend_discovery(Device *device);
+
+  void set_partition_topic(const std::string &topic) { this->partition_topic_ = topic; }
+  void publish_partition(const MeshPartition &partition);
+
+  void set_standby_for(const std::string &topic_prefix) { this->standby_for_ = topic_prefix; }
+  void publish_heartbeat(int online_devices);
+  void publish_topology_chunk(int index, const TopologyChunk &chunk);
+  void announce_takeover();
+  void force_resend_discovery();
+
+  void set_discovery_rate(uint32_t messages_per_second, uint32_t bytes_per_second) {
+    this->discovery_message_limiter_.set_rate(messages_per_second);
+    this->discovery_byte_limiter_.set_rate(bytes_per_second);
+  }
+
+  void set_discovery_abbreviations(bool enabled) { this->discovery_abbreviations_ = enabled; }
+
+  void set_binary_protocol(bool enabled) { this->binary_protocol_ = enabled; }
+
+  void set_bulk_state_interval(uint32_t interval) { this->bulk_state_interval_ = interval; }
+  uint32_t get_bulk_state_interval() const { return this->bulk_state_interval_; }
+  void publish_bulk_state();
 };
 
 }  // namespace awox_mesh
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "mesh_command.h"
+#include "mesh_destination.h"
+
+namespace esphome {
+namespace awox_mesh {
+
+/*
+ Binary command (6 bytes, a payload can contain multiple commands):
+ bytes 0-1 : destination (mesh id or 0x8000 + group id)
+ byte  2   : MeshCommandOp
+ bytes 3-5 : value (raw mesh value, color uses R, G, B)
+
+ Binary state (9 bytes):
+ bytes 0-1 : destination
+ bytes 2-8 : MeshDestinationState
+
+All multi-byte elements are in little-endian form.
+*/
+#define BINARY_COMMAND_SIZE 6
+#define BINARY_STATE_SIZE 9
+
+static bool decode_binary_command(const uint8_t *data, MeshCommand *command) {
+  command->dest = data[0] | (data[1] << 8);
+  command->op = data[2];
+  memcpy(command->value, data + 3, 3);
+
+  return command->op >= MESH_COMMAND_POWER && command->op <= MESH_COMMAND_REQUEST_STATUS;
+}
+
+static void encode_binary_state(int dest, const MeshDestinationState &state, uint8_t *data) {
+  data[0] = dest & 0xff;
+  data[1] = (dest >> 8) & 0xff;
+  memcpy(data + 2, state.state, sizeof(state.state));
+}
+
+}  // namespace awox_mesh
+}  // namespace esphome
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace awox_mesh {
+
+enum DeadlineType : uint8_t {
+  /** Device info not received, request it again */
+  DEADLINE_DEVICE_INFO_RETRY = 0,
+  /** Group got its device info, send discovery */
+  DEADLINE_GROUP_DISCOVERY,
+  /** Clear the RSSI of devices that were not seen for a while */
+  DEADLINE_RSSI_CLEANUP,
+  /** Probe the device that was silent for the longest time */
+  DEADLINE_LIVENESS_PROBE,
+  /** Debounce time of a pending device availability passed */
+  DEADLINE_AVAILABILITY_PUBLISH,
+};
+
+struct Deadline {
+  uint32_t at;
+  DeadlineType type;
+  /** Device or group, depending on the type */
+  void *target;
+};
+
+/**
+ * Min-heap of deadlines, so the loop only has to look at the earliest one.
+ *
+ * Deadlines are compared relative to each other, which keeps the order right when millis() wraps.
+ */
+class DeadlineQueue {
+  std::vector<Deadline> heap_;
+
+  static bool later(const Deadline &a, const Deadline &b) { return (int32_t)(a.at - b.at) > 0; }
+
+ public:
+  void push(uint32_t at, DeadlineType type, void *target = nullptr) {
+    this->heap_.push_back({at, type, target});
+    std::push_heap(this->heap_.begin(), this->heap_.end(), later);
+  }
+
+  bool expired(uint32_t now) const { return !this->heap_.empty() && (int32_t)(now - this->heap_.front().at) >= 0; }
+
+  Deadline pop() {
+    std::pop_heap(this->heap_.begin(), this->heap_.end(), later);
+    Deadline deadline = this->heap_.back();
+    this->heap_.pop_back();
+    return deadline;
+  }
+
+  void remove(DeadlineType type) {
+    this->heap_.erase(std::remove_if(this->heap_.begin(), this->heap_.end(),
+                                     [type](const Deadline &deadline) { return deadline.type == type; }),
+                      this->heap_.end());
+    std::make_heap(this->heap_.begin(), this->heap_.end(), later);
+  }
+
+  size_t size() const { return this->heap_.size(); }
+};
+
+}  // namespace awox_mesh
+}  // namespace esphome
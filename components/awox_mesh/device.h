@@ -27,10 +27,27 @@ class Device : public MeshDestination {
 
   int product_id;
 
+  /** Position in the mesh devices of the hub, used to index per device tables */
+  uint16_t index = 0;
+
   uint32_t last_online = 0;
 
+  /** Liveness probes not answered since the last report of this device */
+  uint8_t liveness_probes = 0;
+
+  uint32_t last_liveness_probe = 0;
+
   uint32_t device_info_requested = 0;
 
+  /** Boots since the cached topology of this device was confirmed by the mesh */
+  uint8_t topology_age = 0;
+
+  /** Cached topology is too old, request the device info again once the device is online */
+  bool topology_stale = false;
+
+  /** Number of mesh devices reachable when connected to this device, remembered across reboots */
+  uint8_t known_reach = 0;
+
   int dest() override { return this->mesh_id; };
 
   const char *type() const override { return "device"; }
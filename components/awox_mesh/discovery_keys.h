@@ -0,0 +1,106 @@
+#pragma once
+
+#include "esphome/components/mqtt/mqtt_const.h"
+
+namespace esphome {
+namespace awox_mesh {
+
+/** Home Assistant discovery keys, see https://www.home-assistant.io/integrations/mqtt/#discovery-messages */
+struct DiscoveryKeys {
+  const char *schema;
+  const char *name;
+  const char *unique_id;
+  const char *icon;
+  const char *entity_category;
+  const char *enabled_by_default;
+  const char *state_topic;
+  const char *command_topic;
+  const char *availability;
+  const char *availability_topic;
+  const char *availability_mode;
+  const char *topic;
+  const char *value_template;
+  const char *payload_on;
+  const char *payload_off;
+  const char *brightness;
+  const char *brightness_scale;
+  const char *supported_color_modes;
+  const char *effect;
+  const char *effect_list;
+  const char *min_mireds;
+  const char *max_mireds;
+  const char *device;
+  const char *device_identifiers;
+  const char *device_name;
+  const char *device_model;
+  const char *device_manufacturer;
+  const char *device_via_device;
+  const char *device_serial_number;
+};
+
+static const DiscoveryKeys DISCOVERY_KEYS = {
+    "schema",
+    mqtt::MQTT_NAME,
+    mqtt::MQTT_UNIQUE_ID,
+    mqtt::MQTT_ICON,
+    mqtt::MQTT_ENTITY_CATEGORY,
+    mqtt::MQTT_ENABLED_BY_DEFAULT,
+    mqtt::MQTT_STATE_TOPIC,
+    mqtt::MQTT_COMMAND_TOPIC,
+    mqtt::MQTT_AVAILABILITY,
+    mqtt::MQTT_AVAILABILITY_TOPIC,
+    mqtt::MQTT_AVAILABILITY_MODE,
+    mqtt::MQTT_TOPIC,
+    mqtt::MQTT_VALUE_TEMPLATE,
+    mqtt::MQTT_PAYLOAD_ON,
+    mqtt::MQTT_PAYLOAD_OFF,
+    "brightness",
+    "brightness_scale",
+    "supported_color_modes",
+    "effect",
+    mqtt::MQTT_EFFECT_LIST,
+    mqtt::MQTT_MIN_MIREDS,
+    mqtt::MQTT_MAX_MIREDS,
+    mqtt::MQTT_DEVICE,
+    mqtt::MQTT_DEVICE_IDENTIFIERS,
+    mqtt::MQTT_DEVICE_NAME,
+    mqtt::MQTT_DEVICE_MODEL,
+    mqtt::MQTT_DEVICE_MANUFACTURER,
+    "via_device",
+    "serial_number",
+};
+
+static const DiscoveryKeys DISCOVERY_KEYS_ABBREVIATED = {
+    "schema",
+    "name",
+    "uniq_id",
+    "ic",
+    "ent_cat",
+    "en",
+    "stat_t",
+    "cmd_t",
+    "avty",
+    "avty_t",
+    "avty_mode",
+    "t",
+    "val_tpl",
+    "pl_on",
+    "pl_off",
+    "brightness",
+    "bri_scl",
+    "sup_clrm",
+    "effect",
+    "fx_list",
+    "min_mirs",
+    "max_mirs",
+    "dev",
+    "ids",
+    "name",
+    "mdl",
+    "mf",
+    "via_device",
+    "sn",
+};
+
+}  // namespace awox_mesh
+}  // namespace esphome
@@ -23,6 +23,9 @@ class Group : public MeshDestination {
 
   uint32_t last_online = 0;
 
+  /** Group state needs to be synced with its devices before the next publication */
+  bool sync_pending = false;
+
   int dest() override { return this->group_id + 0x8000; }
 
   const char *type() const override { return "group"; }
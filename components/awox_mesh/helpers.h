@@ -2,6 +2,8 @@
 
 #include <string>
 #include <bitset>
+#include <algorithm>
+#include <cmath>
 
 namespace esphome {
 namespace awox_mesh {
@@ -33,5 +35,12 @@ static std::string int_as_hex_string(unsigned char hex1, unsigned char hex2, uns
   return std::string((char *) value, 6);
 }
 
+static int convert_value_to_available_range(int value, int min_from, int max_from, int min_to, int max_to) {
+  float normalized = (float) (value - min_from) / (float) (max_from - min_from);
+  int new_value = std::min((int) round((normalized * (float) (max_to - min_to)) + min_to), max_to);
+
+  return std::max(new_value, min_to);
+}
+
 }  // namespace awox_mesh
 }  // namespace esphome
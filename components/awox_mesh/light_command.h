@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstdint>
+#include "mesh_command.h"
+#include "mesh_destination.h"
+#include "helpers.h"
+
+namespace esphome {
+namespace awox_mesh {
+
+#define LIGHT_COMMAND_STATE (1 << 0)
+#define LIGHT_COMMAND_BRIGHTNESS (1 << 1)
+#define LIGHT_COMMAND_COLOR (1 << 2)
+#define LIGHT_COMMAND_COLOR_TEMP (1 << 3)
+#define LIGHT_COMMAND_EFFECT (1 << 4)
+#define LIGHT_COMMAND_FADE_DURATION (1 << 5)
+#define LIGHT_COMMAND_COLOR_DURATION (1 << 6)
+
+#define MESH_COMMAND_PLAN_MAX_SIZE 8
+
+enum LightCommandState : uint8_t {
+  LIGHT_STATE_NONE = 0,
+  LIGHT_STATE_ON,
+  LIGHT_STATE_OFF,
+  LIGHT_STATE_TOGGLE,
+};
+
+enum LightCommandEffect : uint8_t {
+  LIGHT_EFFECT_STOP = 0,
+  LIGHT_EFFECT_CANDLE,
+  LIGHT_EFFECT_COLOR_LOOP,
+};
+
+/**
+ * Home Assistant (JSON schema) light command, decoded in a single pass.
+ *
+ * Values are in Home Assistant ranges, `present` holds the LIGHT_COMMAND_* bits of the fields in the payload.
+ */
+struct LightCommand {
+  uint8_t present = 0;
+  uint8_t state = LIGHT_STATE_NONE;
+  uint8_t effect = LIGHT_EFFECT_STOP;
+  uint8_t red = 0;
+  uint8_t green = 0;
+  uint8_t blue = 0;
+  int brightness = 0;
+  int color_temp = 0;
+  int fade_duration = 0;
+  int color_duration = 0;
+
+  bool has(uint8_t field) const { return (this->present & field) != 0; }
+};
+
+/** Ordered list of mesh commands for 1 destination */
+struct MeshCommandPlan {
+  MeshCommand commands[MESH_COMMAND_PLAN_MAX_SIZE];
+  uint8_t size = 0;
+
+  void add(int dest, uint8_t op, uint8_t value0 = 0, uint8_t value1 = 0, uint8_t value2 = 0) {
+    MeshCommand *command = nullptr;
+
+    // The same operation twice only results in the last value, keep the position of the first
+    for (uint8_t i = 0; i < this->size; i++) {
+      if (this->commands[i].op == op) {
+        command = &this->commands[i];
+        break;
+      }
+    }
+
+    if (command == nullptr) {
+      if (this->size == MESH_COMMAND_PLAN_MAX_SIZE) {
+        return;
+      }
+      command = &this->commands[this->size++];
+    }
+
+    command->dest = dest;
+    command->op = op;
+    command->value[0] = value0;
+    command->value[1] = value1;
+    command->value[2] = value2;
+  }
+};
+
+/**
+ * Plan the mesh commands needed to bring the destination to the requested state.
+ *
+ * The destination state is updated optimistically with the requested values.
+ */
+inline void plan_light_command(const LightCommand &command, MeshDestination *mesh_destination, MeshCommandPlan *plan) {
+  const int dest = mesh_destination->dest();
+  bool state_set = false;
+
+  // Color loop settings first so they are active when the color loop starts
+  if (command.has(LIGHT_COMMAND_FADE_DURATION)) {
+    plan->add(dest, MESH_COMMAND_SEQUENCE_FADE_DURATION, command.fade_duration);
+  }
+
+  if (command.has(LIGHT_COMMAND_COLOR_DURATION)) {
+    plan->add(dest, MESH_COMMAND_SEQUENCE_COLOR_DURATION, command.color_duration);
+  }
+
+  // Mode (color or white temperature) before brightness, brightness applies to the active mode
+  const bool color_brightness =
+      !command.has(LIGHT_COMMAND_COLOR_TEMP) && (command.has(LIGHT_COMMAND_COLOR) || mesh_destination->color_mode);
+
+  if (command.has(LIGHT_COMMAND_COLOR)) {
+    state_set = true;
+    mesh_destination->state = true;
+    mesh_destination->color_mode = true;
+    mesh_destination->R = command.red;
+    mesh_destination->G = command.green;
+    mesh_destination->B = command.blue;
+
+    plan->add(dest, MESH_COMMAND_COLOR, command.red, command.green, command.blue);
+  }
+
+  if (command.has(LIGHT_COMMAND_COLOR_TEMP)) {
+    int temperature = convert_value_to_available_range(command.color_temp, 153, 370, 0, 0x7f);
+
+    state_set = true;
+    mesh_destination->state = true;
+    mesh_destination->color_mode = false;
+    mesh_destination->temperature = temperature;
+
+    plan->add(dest, MESH_COMMAND_WHITE_TEMPERATURE, temperature);
+  }
+
+  if (command.has(LIGHT_COMMAND_BRIGHTNESS) && color_brightness) {
+    int brightness = convert_value_to_available_range(command.brightness, 0, 255, 0xa, 0x64);
+
+    state_set = true;
+    mesh_destination->state = true;
+    mesh_destination->color_brightness = brightness;
+
+    plan->add(dest, MESH_COMMAND_COLOR_BRIGHTNESS, brightness);
+  } else if (command.has(LIGHT_COMMAND_BRIGHTNESS)) {
+    int brightness = convert_value_to_available_range(command.brightness, 0, 255, 1, 0x7f);
+
+    state_set = true;
+    mesh_destination->state = true;
+    mesh_destination->white_brightness = brightness;
+
+    plan->add(dest, MESH_COMMAND_WHITE_BRIGHTNESS, brightness);
+  }
+
+  if (command.has(LIGHT_COMMAND_EFFECT)) {
+    state_set = true;
+    mesh_destination->state = true;
+    mesh_destination->sequence_mode = command.effect == LIGHT_EFFECT_COLOR_LOOP;
+    mesh_destination->candle_mode = command.effect == LIGHT_EFFECT_CANDLE;
+
+    if (command.effect == LIGHT_EFFECT_COLOR_LOOP) {
+      plan->add(dest, MESH_COMMAND_SEQUENCE, 0);
+    } else if (command.effect == LIGHT_EFFECT_CANDLE) {
+      plan->add(dest, MESH_COMMAND_CANDLE_MODE);
+    } else if (mesh_destination->color_mode) {
+      // Stop effect by setting the current color again
+      plan->add(dest, MESH_COMMAND_COLOR, mesh_destination->R, mesh_destination->G, mesh_destination->B);
+    } else {
+      plan->add(dest, MESH_COMMAND_WHITE_TEMPERATURE, mesh_destination->temperature);
+    }
+  }
+
+  // Power last, setting a color/brightness/effect already turns the light on
+  if (command.has(LIGHT_COMMAND_STATE)) {
+    switch (command.state) {
+      case LIGHT_STATE_ON:
+        mesh_destination->state = true;
+        if (!state_set) {
+          plan->add(dest, MESH_COMMAND_POWER, 1);
+        }
+        break;
+      case LIGHT_STATE_OFF:
+        mesh_destination->state = false;
+        plan->add(dest, MESH_COMMAND_POWER, 0);
+        break;
+      case LIGHT_STATE_TOGGLE:
+        mesh_destination->state = !mesh_destination->state;
+        plan->add(dest, MESH_COMMAND_POWER, mesh_destination->state);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+}  // namespace awox_mesh
+}  // namespace esphome
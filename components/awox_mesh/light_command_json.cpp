@@ -0,0 +1,68 @@
+#include <cstring>
+#include <strings.h>
+#include "light_command_json.h"
+
+namespace esphome {
+namespace awox_mesh {
+
+static uint8_t parse_light_state(const char *value) {
+  if (value == nullptr) {
+    return LIGHT_STATE_NONE;
+  }
+  if (strcasecmp(value, "on") == 0) {
+    return LIGHT_STATE_ON;
+  }
+  if (strcasecmp(value, "off") == 0) {
+    return LIGHT_STATE_OFF;
+  }
+  if (strcasecmp(value, "toggle") == 0) {
+    return LIGHT_STATE_TOGGLE;
+  }
+  return LIGHT_STATE_NONE;
+}
+
+static uint8_t parse_light_effect(const char *value) {
+  if (value != nullptr && strcmp(value, "color loop") == 0) {
+    return LIGHT_EFFECT_COLOR_LOOP;
+  }
+  if (value != nullptr && strcmp(value, "candle") == 0) {
+    return LIGHT_EFFECT_CANDLE;
+  }
+  return LIGHT_EFFECT_STOP;
+}
+
+void decode_light_command(JsonObject root, LightCommand *command) {
+  for (JsonPair field : root) {
+    const char *key = field.key().c_str();
+    JsonVariant value = field.value();
+
+    if (strcmp(key, "state") == 0) {
+      command->state = parse_light_state(value.as<const char *>());
+      command->present |= LIGHT_COMMAND_STATE;
+    } else if (strcmp(key, "brightness") == 0) {
+      command->brightness = value.as<int>();
+      command->present |= LIGHT_COMMAND_BRIGHTNESS;
+    } else if (strcmp(key, "color") == 0) {
+      JsonObject color = value.as<JsonObject>();
+      command->red = color["r"].as<int>();
+      command->green = color["g"].as<int>();
+      command->blue = color["b"].as<int>();
+      command->present |= LIGHT_COMMAND_COLOR;
+    } else if (strcmp(key, "color_temp") == 0) {
+      command->color_temp = value.as<int>();
+      command->present |= LIGHT_COMMAND_COLOR_TEMP;
+    } else if (strcmp(key, "effect") == 0) {
+      command->effect = parse_light_effect(value.as<const char *>());
+      command->present |= LIGHT_COMMAND_EFFECT;
+    } else if (strcmp(key, "fade_duration") == 0) {
+      command->fade_duration = value.as<int>();
+      command->present |= LIGHT_COMMAND_FADE_DURATION;
+    } else if (strcmp(key, "color_duration") == 0) {
+      command->color_duration = value.as<int>();
+      command->present |= LIGHT_COMMAND_COLOR_DURATION;
+    }
+  }
+}
+
+}  // namespace awox_mesh
+}  // namespace esphome
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include "light_command.h"
+
+namespace esphome {
+namespace awox_mesh {
+
+/** Decode a Home Assistant (JSON schema) light command in a single pass over its fields */
+void decode_light_command(JsonObject root, LightCommand *command);
+
+}  // namespace awox_mesh
+}  // namespace esphome
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace awox_mesh {
+
+/** Operations that can be send to a mesh destination, each maps on 1 of the AwoxMesh::set_* methods */
+enum MeshCommandOp : uint8_t {
+  MESH_COMMAND_POWER = 0x01,
+  MESH_COMMAND_COLOR = 0x02,
+  MESH_COMMAND_COLOR_BRIGHTNESS = 0x03,
+  MESH_COMMAND_WHITE_BRIGHTNESS = 0x04,
+  MESH_COMMAND_WHITE_TEMPERATURE = 0x05,
+  MESH_COMMAND_SEQUENCE = 0x06,
+  MESH_COMMAND_CANDLE_MODE = 0x07,
+  MESH_COMMAND_SEQUENCE_FADE_DURATION = 0x08,
+  MESH_COMMAND_SEQUENCE_COLOR_DURATION = 0x09,
+  MESH_COMMAND_REQUEST_STATUS = 0x0A,
+};
+
+struct MeshCommand {
+  int dest;
+  uint8_t op;
+  /** Raw mesh values, only color uses all 3 bytes (R, G, B) */
+  uint8_t value[3];
+};
+
+}  // namespace awox_mesh
+}  // namespace esphome
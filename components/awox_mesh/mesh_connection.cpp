@@ -8,6 +8,7 @@
 #include "helpers.h"
 #include "group.h"
 #include "aes/esp_aes.h"
+#include "esp_heap_caps.h"
 #include "esphome/core/application.h"
 #include "esphome/core/hal.h"
 #include "esphome/core/helpers.h"
@@ -54,11 +55,123 @@ void MeshConnection::connect_to(FoundDevice *found_device) {
   this->found_device = found_device;
   this->found_device->connected = true;
 
+  this->free_heap_before_connect_ = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+
   this->set_auto_connect(true);
   this->parse_device(found_device->device);
   if (this->found_device->mesh_id) {
     this->add_mesh_id(this->found_device->mesh_id);
   }
+  this->set_slot_state_(SLOT_CONNECTING);
+}
+
+void MeshConnection::set_slot_state_(MeshConnectionSlotState state) {
+  if (this->slot_state_ == state) {
+    return;
+  }
+  ESP_LOGD(TAG, "[%d] Slot %s => %s", this->connection_index_, slot_state_to_string(this->slot_state_),
+           slot_state_to_string(state));
+  this->slot_state_ = state;
+  this->slot_state_since_ = esphome::millis();
+
+  if (state == SLOT_READY) {
+    this->link_rssi_ = 0;
+    this->missed_responses_ = 0;
+    this->reply_expected_since_ = 0;
+    this->last_link_check_ = this->slot_state_since_;
+    this->last_notification_ = this->slot_state_since_;
+    this->awaiting_response_since_ = 0;
+
+    // Only a rough estimate, allocations of other connections that are established at the same time are included
+    const size_t free_heap = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    if (this->free_heap_before_connect_ > free_heap) {
+      this->heap_cost_ = this->free_heap_before_connect_ - free_heap;
+      ESP_LOGI(TAG, "[%d] Connection takes %u bytes of heap, %u bytes free", this->connection_index_,
+               this->heap_cost_, free_heap);
+    }
+  } else if (state == SLOT_IDLE) {
+    // The slot stays unused until the next connection attempt, free the discovered GATT services
+    this->notification_char = nullptr;
+    this->command_char = nullptr;
+    this->pair_char = nullptr;
+    this->release_services();
+  }
+}
+
+bool MeshConnection::degraded() const {
+  if (this->slot_state_ != SLOT_READY) {
+    return false;
+  }
+  return (this->link_rssi_ != 0 && this->link_rssi_ < this->degraded_rssi) ||
+         this->missed_responses_ >= this->max_missed_responses;
+}
+
+void MeshConnection::check_link_quality_() {
+  const uint32_t now = esphome::millis();
+  this->last_link_check_ = now;
+
+  // Commands are answered by status notifications of the mesh devices
+  if (this->reply_expected_since_ != 0 && now - this->reply_expected_since_ > 2000) {
+    this->reply_expected_since_ = 0;
+    if (this->missed_responses_ < UINT8_MAX) {
+      this->missed_responses_++;
+    }
+    ESP_LOGD(TAG, "[%d] [%s] No notification since command (%u commands in a row)", this->connection_index_,
+             this->address_str_, this->missed_responses_);
+  }
+
+  esp_err_t status = esp_ble_gap_read_rssi(this->get_remote_bda());
+  if (status != ESP_OK) {
+    ESP_LOGW(TAG, "[%d] [%s] esp_ble_gap_read_rssi failed, error=%d", this->connection_index_, this->address_str_,
+             status);
+  }
+}
+
+void MeshConnection::gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+  esp32_ble_client::BLEClientBase::gap_event_handler(event, param);
+
+  if (event != ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT || this->slot_state_ != SLOT_READY ||
+      memcmp(param->read_rssi_cmpl.remote_addr, this->get_remote_bda(), sizeof(esp_bd_addr_t)) != 0) {
+    return;
+  }
+  if (param->read_rssi_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+    ESP_LOGW(TAG, "[%d] [%s] Reading link RSSI failed, status=%d", this->connection_index_, this->address_str_,
+             param->read_rssi_cmpl.status);
+    return;
+  }
+
+  const int rssi = param->read_rssi_cmpl.rssi;
+  this->link_rssi_ = this->link_rssi_ == 0 ? rssi : (this->link_rssi_ * 3 + rssi) / 4;
+  ESP_LOGV(TAG, "[%d] [%s] Link RSSI %d (smoothed %d)", this->connection_index_, this->address_str_, rssi,
+           this->link_rssi_);
+}
+
+std::deque<QueuedCommand> MeshConnection::take_queued_commands() {
+  std::deque<QueuedCommand> commands;
+  commands.swap(this->command_queue);
+  return commands;
+}
+
+void MeshConnection::add_queued_command(QueuedCommand &&command) { this->command_queue.push_back(std::move(command)); }
+
+void MeshConnection::add_queued_commands(std::deque<QueuedCommand> &&commands) {
+  for (QueuedCommand &command : commands) {
+    this->add_queued_command(std::move(command));
+  }
+}
+
+void MeshConnection::expire_queued_commands_() {
+  if (this->command_max_age == 0) {
+    return;
+  }
+
+  const uint32_t now = esphome::millis();
+  while (!this->command_queue.empty() && now - this->command_queue.front().queued_at > this->command_max_age) {
+    QueuedCommand &item = this->command_queue.front();
+    ESP_LOGI(TAG, "[%d] Drop command %02X for dest: %u, queued %u ms ago", this->connection_index_, item.command,
+             (int) item.dest, now - item.queued_at);
+    this->command_queue.pop_front();
+  }
 }
 
 void MeshConnection::set_address(uint64_t address) {
@@ -67,10 +180,26 @@ void MeshConnection::set_address(uint64_t address) {
   }
 
   if (address == 0) {
+    if (this->establishing()) {
+      this->mesh_->connection_failed(this->found_device, this->pairing_rejected_);
+    }
+    if (this->slot_state_ != SLOT_IDLE) {
+      this->set_slot_state_(SLOT_COOLING_DOWN);
+    }
+    this->pairing_rejected_ = false;
+
+    // Give the remaining connections a chance to send the pending commands
+    if (!this->command_queue.empty()) {
+      this->mesh_->reroute_commands(this, this->take_queued_commands());
+    }
+
     this->disconnect_callback();
 
-    // Mark each linked mesh device as offline
+    // Mark each linked mesh device as offline, unless it is still reachable through another connection
     for (int mesh_id : this->linked_mesh_ids_) {
+      if (this->mesh_->mesh_id_linked_elsewhere(mesh_id, this)) {
+        continue;
+      }
       Device *device = this->mesh_->get_device(mesh_id);
       if (device != nullptr) {
         device->online = false;
@@ -101,15 +230,34 @@ void MeshConnection::set_address(uint64_t address) {
 void MeshConnection::loop() {
   esp32_ble_client::BLEClientBase::loop();
 
+  const uint32_t in_slot_state = esphome::millis() - this->slot_state_since_;
+  if (this->establishing() && in_slot_state > this->connect_timeout) {
+    ESP_LOGW(TAG, "[%d] [%s] Not ready within %u ms (%s), abort", this->connection_index_, this->address_str_,
+             this->connect_timeout, slot_state_to_string(this->slot_state_));
+    this->disconnect();
+    this->set_address(0);
+  } else if (this->slot_state_ == SLOT_COOLING_DOWN && in_slot_state > this->cool_down_time) {
+    this->set_slot_state_(SLOT_IDLE);
+  } else if (this->slot_state_ == SLOT_READY && esphome::millis() - this->last_link_check_ > this->link_check_interval) {
+    this->check_link_quality_();
+  }
+
+  this->expire_queued_commands_();
+
   if (this->connected() && !this->command_queue.empty() &&
-      this->last_send_command < esphome::millis() - this->command_debounce_time) {
+      this->last_send_command < esphome::millis() - (this->command_queue.front().burst
+                                                         ? this->command_burst_debounce_time
+                                                         : this->command_debounce_time)) {
     ESP_LOGV(TAG, "Send command, time since last command: %d", (int) (esphome::millis() - this->last_send_command));
     this->last_send_command = esphome::millis();
     QueuedCommand item = this->command_queue.front();
     ESP_LOGV(TAG, "Send command %u, for dest: %u", item.command, item.dest);
     this->command_queue.pop_front();
     ESP_LOGV(TAG, "Remove item from queue");
-    this->write_command(item.command, item.data, item.dest, false);
+    if (this->write_command(item.command, item.data, item.dest, false) && this->reply_expected_since_ == 0 &&
+        this->reply_expected_(item)) {
+      this->reply_expected_since_ = this->last_send_command;
+    }
 
     if (!this->command_queue.empty()) {
       ESP_LOGI(TAG, "still %d queued commands", this->command_queue.size());
@@ -156,11 +304,24 @@ bool MeshConnection::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if
         ESP_LOGW(TAG, "Notification received from different connection, skipped");
         break;
       }
-      if (param->notify.handle != this->notification_char->handle) {
+      if (this->notification_char == nullptr || param->notify.handle != this->notification_char->handle) {
         ESP_LOGW(TAG, "Unknown notification received from handle %d: %s", param->notify.handle,
                  string_as_hex_string(std::string((char *) param->notify.value, param->notify.value_len)).c_str());
         break;
       }
+      this->last_notification_ = esphome::millis();
+      this->missed_responses_ = 0;
+      this->reply_expected_since_ = 0;
+
+      if (this->awaiting_response_since_ != 0) {
+        const uint32_t latency = this->last_notification_ - this->awaiting_response_since_;
+        this->awaiting_response_since_ = 0;
+        // Commands without any response are already counted as missed responses
+        if (latency < this->link_check_interval) {
+          this->mesh_->record_command_latency(latency);
+        }
+      }
+
       std::string notification = std::string((char *) param->notify.value, param->notify.value_len);
       std::string packet = this->decrypt_packet(notification);
       ESP_LOGV(TAG, "Notification received: %s", string_as_hex_string(packet).c_str());
@@ -175,7 +336,7 @@ bool MeshConnection::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if
         ESP_LOGW(TAG, "Error reading char at handle %d, status=%d", param->read.handle, param->read.status);
         break;
       }
-      if (param->read.handle == this->pair_char->handle) {
+      if (this->pair_char != nullptr && param->read.handle == this->pair_char->handle) {
         if (param->read.value[0] == 0xd) {
           ESP_LOGI(TAG, "Response OK, let's go");
           this->generate_session_key(this->random_key,
@@ -184,12 +345,15 @@ bool MeshConnection::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if
           ESP_LOGI(TAG, "[%u] [%s] session key %s", this->get_conn_id(), this->address_str_,
                    string_as_hex_string(this->session_key).c_str());
 
+          this->set_slot_state_(SLOT_READY);
+          this->mesh_->connection_ready(this->found_device);
           this->request_status();
 
           break;
         } else if (param->read.value[0] == 0xe) {
           ESP_LOGE(TAG, "Device authentication error: known mesh credentials are not excepted by the device. Did you "
                         "re-pair them to your Awox app with a different account?");
+          this->pairing_rejected_ = true;
         } else {
           ESP_LOGE(TAG, "Unexpected pair value");
         }
@@ -238,6 +402,8 @@ void MeshConnection::setup_connection() {
     return;
   }
 
+  this->set_slot_state_(SLOT_AUTHENTICATING);
+
   unsigned char key[8];
   esp_fill_random(key, 8);
   this->random_key = std::string((char *) key).substr(0, 8);
@@ -425,6 +591,9 @@ void MeshConnection::handle_packet(std::string &packet) {
     ESP_LOGD(TAG, "MAC report, dev [%u]: productID: 0x%02X mac: %s", mesh_id, device->product_id,
              device->address_str().c_str());
 
+    device->topology_age = 0;
+    device->topology_stale = false;
+
     this->mesh_->send_discovery(device);
     return;
   } else if (static_cast<unsigned char>(packet[7]) == COMMAND_GROUP_ID_REPORT) {
@@ -484,6 +653,7 @@ void MeshConnection::handle_packet(std::string &packet) {
   device->G = G;
   device->B = B;
   device->last_online = esphome::millis();
+  device->liveness_probes = 0;
 
   // todo move logic below to mesh or mqtt class
   ESP_LOGI(TAG, device->state_as_string().c_str());
@@ -513,15 +683,42 @@ void MeshConnection::add_mesh_id(int mesh_id) {
   if (!this->mesh_id_linked(mesh_id)) {
     this->linked_mesh_ids_.push_back(mesh_id);
     sort(this->linked_mesh_ids_.begin(), this->linked_mesh_ids_.end());
+    this->linked_mesh_ids_version_++;
+  }
+
+  // Remember the reach of this node, used to plan new connections
+  if (this->found_device != nullptr) {
+    std::vector<int> &reachable = this->found_device->reachable_mesh_ids;
+    std::vector<int>::iterator position = std::lower_bound(reachable.begin(), reachable.end(), mesh_id);
+    if (position == reachable.end() || *position != mesh_id) {
+      reachable.insert(position, mesh_id);
+    }
   }
 }
 
 void MeshConnection::remove_mesh_id(int mesh_id) {
-  this->linked_mesh_ids_.erase(std::remove(this->linked_mesh_ids_.begin(), this->linked_mesh_ids_.end(), mesh_id),
-                               this->linked_mesh_ids_.end());
+  std::vector<int>::iterator position =
+      std::remove(this->linked_mesh_ids_.begin(), this->linked_mesh_ids_.end(), mesh_id);
+  if (position != this->linked_mesh_ids_.end()) {
+    this->linked_mesh_ids_.erase(position, this->linked_mesh_ids_.end());
+    this->linked_mesh_ids_version_++;
+  }
 }
 
-void MeshConnection::clear_linked_mesh_ids() { this->linked_mesh_ids_.clear(); }
+bool MeshConnection::reply_expected_(const QueuedCommand &item) {
+  if (item.probe) {
+    return false;
+  }
+  // Devices not linked through this connection are offline, groups and broadcasts are answered by online members
+  return item.dest >= 0x8000 || this->mesh_id_linked(item.dest);
+}
+
+void MeshConnection::clear_linked_mesh_ids() {
+  if (!this->linked_mesh_ids_.empty()) {
+    this->linked_mesh_ids_.clear();
+    this->linked_mesh_ids_version_++;
+  }
+}
 
 std::string MeshConnection::build_packet(int dest, int command, const std::string &data) {
   /* Telink mesh packets take the following form:
@@ -564,6 +761,7 @@ void MeshConnection::queue_command(int command, const std::string &data, int des
   item.data = data;
   item.command = command;
   item.dest = dest;
+  item.queued_at = esphome::millis();
   this->command_queue.push_back(item);
 }
 
@@ -573,6 +771,9 @@ bool MeshConnection::write_command(int command, const std::string &data, int des
   std::string packet = this->build_packet(dest, command, data);
   // todo: withResponse
   auto status = this->command_char->write_value((uint8_t *) packet.data(), packet.size());
+  if (status == ESP_OK && this->awaiting_response_since_ == 0) {
+    this->awaiting_response_since_ = esphome::millis();
+  }
   // todo: check write return value
   return status ? false : true;
 }
@@ -618,6 +819,59 @@ void MeshConnection::set_sequence_color_duration(int dest, int duration) {
 
 void MeshConnection::request_status_update(int dest) { this->queue_command(C_REQUEST_STATUS, {0x10}, dest); }
 
+void MeshConnection::send_liveness_probe(int dest) {
+  this->queue_command(C_REQUEST_STATUS, {0x10}, dest);
+  this->command_queue.back().probe = true;
+}
+
+void MeshConnection::queue_mesh_command(const MeshCommand &command) {
+  switch (command.op) {
+    case MESH_COMMAND_POWER:
+      this->set_power(command.dest, command.value[0] > 0);
+      break;
+    case MESH_COMMAND_COLOR:
+      this->set_color(command.dest, command.value[0], command.value[1], command.value[2]);
+      break;
+    case MESH_COMMAND_COLOR_BRIGHTNESS:
+      this->set_color_brightness(command.dest, command.value[0]);
+      break;
+    case MESH_COMMAND_WHITE_BRIGHTNESS:
+      this->set_white_brightness(command.dest, command.value[0]);
+      break;
+    case MESH_COMMAND_WHITE_TEMPERATURE:
+      this->set_white_temperature(command.dest, command.value[0]);
+      break;
+    case MESH_COMMAND_SEQUENCE:
+      this->set_sequence(command.dest, command.value[0]);
+      break;
+    case MESH_COMMAND_CANDLE_MODE:
+      this->set_candle_mode(command.dest);
+      break;
+    case MESH_COMMAND_SEQUENCE_FADE_DURATION:
+      this->set_sequence_fade_duration(command.dest, command.value[0]);
+      break;
+    case MESH_COMMAND_SEQUENCE_COLOR_DURATION:
+      this->set_sequence_color_duration(command.dest, command.value[0]);
+      break;
+    case MESH_COMMAND_REQUEST_STATUS:
+      this->request_status_update(command.dest);
+      break;
+    default:
+      ESP_LOGW(TAG, "[%d] Unknown command %02X", command.dest, command.op);
+      break;
+  }
+}
+
+void MeshConnection::queue_burst(const MeshCommand *commands, uint8_t size) {
+  // Commands of 1 burst are queued together and send back-to-back (no other destinations in between)
+  for (uint8_t i = 0; i < size; i++) {
+    this->queue_mesh_command(commands[i]);
+    if (i > 0) {
+      this->command_queue.back().burst = true;
+    }
+  }
+}
+
 void MeshConnection::request_device_info(Device *device) {
   this->queue_command(COMMAND_DEVICE_INFO_QUERY, {0x10, 0x00}, device->mesh_id);
 }
@@ -12,6 +12,7 @@
 #include "esphome/components/mqtt/mqtt_client.h"
 #include "device_info.h"
 #include "device.h"
+#include "mesh_command.h"
 
 namespace esphome {
 namespace awox_mesh {
@@ -48,10 +49,40 @@ static std::string uuid_pair_char = "00010203-0405-0607-0809-0a0b0c0d1914";
 #define COMMAND_DEVICE_INFO_REPORT 0xEB
 #define COMMAND_GROUP_ID_QUERY 0xDD
 
+enum MeshConnectionSlotState : uint8_t {
+  SLOT_IDLE = 0,
+  SLOT_CONNECTING,
+  SLOT_AUTHENTICATING,
+  SLOT_READY,
+  SLOT_COOLING_DOWN,
+};
+
+static const char *slot_state_to_string(MeshConnectionSlotState state) {
+  switch (state) {
+    case SLOT_IDLE:
+      return "idle";
+    case SLOT_CONNECTING:
+      return "connecting";
+    case SLOT_AUTHENTICATING:
+      return "authenticating";
+    case SLOT_READY:
+      return "ready";
+    case SLOT_COOLING_DOWN:
+      return "cooling down";
+    default:
+      return "unknown";
+  }
+}
+
 struct QueuedCommand {
   int command;
   std::string data;
   int dest;
+  /** Part of a burst, send directly after the previous command */
+  bool burst;
+  uint32_t queued_at;
+  /** Liveness probe, devices that are switched off don't answer it */
+  bool probe;
 };
 
 struct FoundDevice;
@@ -64,6 +95,40 @@ class MeshConnection : public esp32_ble_client::BLEClientBase {
   int packet_count = 1;
   uint32_t last_send_command = 0;
   uint32_t command_debounce_time = 180;
+  uint32_t command_burst_debounce_time = 50;
+  /** Queued commands older than this are dropped, 0 keeps them */
+  uint32_t command_max_age = 0;
+  /** Maximal time to connect and authenticate before the attempt is aborted */
+  uint32_t connect_timeout = 20000;
+  /** Time to let the BLE stack settle before the slot is used again */
+  uint32_t cool_down_time = 2000;
+
+  MeshConnectionSlotState slot_state_ = SLOT_IDLE;
+  uint32_t slot_state_since_ = 0;
+  /** Device answered the pair request with 0x0e, mesh credentials not accepted */
+  bool pairing_rejected_ = false;
+
+  /** Link quality of a ready connection is checked with this interval */
+  uint32_t link_check_interval = 5000;
+  /** Link RSSI below which the connection is degraded */
+  int degraded_rssi = -85;
+  /** Number of commands in a row without any notification before the connection is degraded */
+  uint8_t max_missed_responses = 3;
+
+  /** Smoothed link RSSI, 0 when not yet known */
+  int link_rssi_ = 0;
+  uint32_t last_link_check_ = 0;
+  uint32_t last_notification_ = 0;
+  uint8_t missed_responses_ = 0;
+  /** Time of the written command a notification is expected for, 0 when none, counted once as missed response */
+  uint32_t reply_expected_since_ = 0;
+  /** Time of the first written command without a notification since, 0 when not waiting */
+  uint32_t awaiting_response_since_ = 0;
+
+  /** Free internal heap when the connection attempt started */
+  size_t free_heap_before_connect_ = 0;
+  /** Internal heap taken by the last established connection, 0 when not yet measured */
+  size_t heap_cost_ = 0;
 
   std::deque<QueuedCommand> command_queue{};
 
@@ -74,14 +139,20 @@ class MeshConnection : public esp32_ble_client::BLEClientBase {
 
   std::string reverse_address;
 
-  FoundDevice *found_device;
+  FoundDevice *found_device = nullptr;
 
-  esp32_ble_client::BLECharacteristic *notification_char;
-  esp32_ble_client::BLECharacteristic *command_char;
-  esp32_ble_client::BLECharacteristic *pair_char;
+  esp32_ble_client::BLECharacteristic *notification_char = nullptr;
+  esp32_ble_client::BLECharacteristic *command_char = nullptr;
+  esp32_ble_client::BLECharacteristic *pair_char = nullptr;
 
   void setup_connection();
 
+  void set_slot_state_(MeshConnectionSlotState state);
+
+  void check_link_quality_();
+
+  void expire_queued_commands_();
+
   std::string combine_name_and_password() const;
 
   void generate_session_key(const std::string &data1, const std::string &data2);
@@ -99,9 +170,10 @@ class MeshConnection : public esp32_ble_client::BLEClientBase {
   void queue_command(int command, const std::string &data, int dest = 0);
 
   void add_mesh_id(int mesh_id);
-  void remove_mesh_id(int mesh_id);
   void clear_linked_mesh_ids();
 
+  bool reply_expected_(const QueuedCommand &item);
+
   virtual void set_state(esp32_ble_tracker::ClientState st) override {
     esp32_ble_client::BLEClientBase::set_state(st);
     ESP_LOGI("awox.connection", "[%d] set_state %s", this->connection_index_, esp32_ble_tracker::client_state_to_string(st));
@@ -113,6 +185,8 @@ class MeshConnection : public esp32_ble_client::BLEClientBase {
   bool gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if,
                            esp_ble_gattc_cb_param_t *param) override;
 
+  void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) override;
+
   void set_address(uint64_t address);
 
   void set_disconnect_callback(std::function<void()> &&f);
@@ -141,6 +215,14 @@ class MeshConnection : public esp32_ble_client::BLEClientBase {
 
   void request_status_update(int dest);
 
+  void send_liveness_probe(int dest);
+
+  void remove_mesh_id(int mesh_id);
+
+  void queue_mesh_command(const MeshCommand &command);
+
+  void queue_burst(const MeshCommand *commands, uint8_t size);
+
   void request_device_info(Device *device);
 
   void request_group_info(Device *device);
@@ -151,14 +233,41 @@ class MeshConnection : public esp32_ble_client::BLEClientBase {
 
   int mesh_id();
 
+  MeshConnectionSlotState get_slot_state() const { return this->slot_state_; }
+
+  /** Connection attempt in progress */
+  bool establishing() const {
+    return this->slot_state_ == SLOT_CONNECTING || this->slot_state_ == SLOT_AUTHENTICATING;
+  }
+
+  uint32_t get_slot_state_since() const { return this->slot_state_since_; }
+
+  int get_link_rssi() const { return this->link_rssi_; }
+
+  size_t get_heap_cost() const { return this->heap_cost_; }
+
+  /** Ready connection with a weak signal or notifications that stay away */
+  bool degraded() const;
+
+  /** Move the not yet send commands out, used to hand them over to another connection */
+  std::deque<QueuedCommand> take_queued_commands();
+
+  void add_queued_command(QueuedCommand &&command);
+
+  void add_queued_commands(std::deque<QueuedCommand> &&commands);
+
   bool mesh_id_linked(int mesh_id);
 
   const std::vector<int> &get_linked_mesh_ids() const { return this->linked_mesh_ids_; }
 
+  /** Changes every time the linked mesh ids change */
+  uint32_t get_linked_mesh_ids_version() const { return this->linked_mesh_ids_version_; }
+
  protected:
   friend class AwoxMesh;
 
   std::vector<int> linked_mesh_ids_;
+  uint32_t linked_mesh_ids_version_ = 0;
 
   std::string mesh_name = "";
   std::string mesh_password = "";
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include "device_info.h"
 
@@ -29,11 +30,15 @@ class MeshDestination {
   bool send_discovery = false;
   DeviceInfo *device_info;
 
-  virtual int dest();
-  virtual const char *type() const;
-  virtual bool can_publish_state();
-  virtual std::vector<Group *> get_groups() const;
-  virtual std::string state_as_string();
+  /** State publication is queued and waits for the publish interval */
+  bool state_publish_pending = false;
+  uint32_t last_state_publish = 0;
+
+  virtual int dest() = 0;
+  virtual const char *type() const = 0;
+  virtual bool can_publish_state() = 0;
+  virtual std::vector<Group *> get_groups() const = 0;
+  virtual std::string state_as_string() = 0;
 
   const MeshDestinationState state_as_char() {
     MeshDestinationState state = {};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace awox_mesh {
+
+/** RSSI announced for mesh ids only reachable through a mesh connection, not by their own advertisements */
+#define PARTITION_RSSI_UNKNOWN -127
+
+/**
+ * What another hub sharing the mesh announced on the partition topic.
+ */
+struct HubAnnouncement {
+  /** Mesh id => best RSSI of its advertisements, PARTITION_RSSI_UNKNOWN when only reachable through the mesh */
+  std::map<int, int> reach{};
+  /** Mesh ids owned by the hub */
+  std::set<int> claims{};
+  uint32_t received = 0;
+};
+
+/**
+ * Splits the mesh devices over multiple hubs.
+ *
+ * Every hub announces the mesh ids it reaches and the ids it claims. A mesh id goes to the hub with the best RSSI,
+ * on equal RSSI the lowest hub id wins. A hub that already claimed a mesh id keeps it until another hub receives it
+ * more than `rssi_margin` dB stronger, this prevents ownership from flapping between hubs at similar distance.
+ * All hubs apply the same rules on the same announcements, so they agree on the owners without further negotiation.
+ */
+class MeshPartition {
+  std::string hub_id_;
+  int rssi_margin_ = 6;
+  /** Announcements not repeated within this time belong to hubs that went away */
+  uint32_t expire_time_ms_ = 60000;
+
+  std::map<int, int> own_reach_{};
+  std::set<int> own_claims_{};
+  std::map<std::string, HubAnnouncement> hubs_{};
+
+  /** True when hub `a` with `rssi_a` is a better owner than hub `b` with `rssi_b` */
+  static bool better_owner(const std::string &a, int rssi_a, const std::string &b, int rssi_b) {
+    return rssi_a > rssi_b || (rssi_a == rssi_b && a < b);
+  }
+
+  std::string owner_of_(int mesh_id, int own_rssi) const {
+    const std::string *best = &this->hub_id_;
+    int best_rssi = own_rssi;
+
+    const std::string *claimer = nullptr;
+    int claimer_rssi = PARTITION_RSSI_UNKNOWN;
+    if (this->own_claims_.count(mesh_id)) {
+      claimer = &this->hub_id_;
+      claimer_rssi = own_rssi;
+    }
+
+    for (auto &hub : this->hubs_) {
+      auto reach = hub.second.reach.find(mesh_id);
+      const int rssi = reach != hub.second.reach.end() ? reach->second : PARTITION_RSSI_UNKNOWN;
+
+      if (reach != hub.second.reach.end() && better_owner(hub.first, rssi, *best, best_rssi)) {
+        best = &hub.first;
+        best_rssi = rssi;
+      }
+
+      // Two hubs can claim the same mesh id for a moment, both settle on the best of them
+      if (hub.second.claims.count(mesh_id) &&
+          (claimer == nullptr || better_owner(hub.first, rssi, *claimer, claimer_rssi))) {
+        claimer = &hub.first;
+        claimer_rssi = rssi;
+      }
+    }
+
+    if (claimer != nullptr && claimer_rssi + this->rssi_margin_ >= best_rssi) {
+      return *claimer;
+    }
+    return *best;
+  }
+
+ public:
+  void set_hub_id(const std::string &hub_id) { this->hub_id_ = hub_id; }
+
+  const std::string &get_hub_id() const { return this->hub_id_; }
+
+  void set_rssi_margin(int rssi_margin) { this->rssi_margin_ = rssi_margin; }
+
+  void set_expire_time(uint32_t expire_time) { this->expire_time_ms_ = expire_time; }
+
+  uint32_t get_expire_time() const { return this->expire_time_ms_; }
+
+  void set_own_reach(std::map<int, int> &&reach) { this->own_reach_ = std::move(reach); }
+
+  const std::map<int, int> &get_own_reach() const { return this->own_reach_; }
+
+  const std::set<int> &get_own_claims() const { return this->own_claims_; }
+
+  size_t get_hub_count() const { return this->hubs_.size() + 1; }
+
+  /** Store the announcement of another hub, returns true when the hub wasn't known yet */
+  bool process_announcement(const std::string &hub_id, HubAnnouncement &&announcement) {
+    if (hub_id == this->hub_id_) {
+      return false;
+    }
+
+    const bool added = this->hubs_.find(hub_id) == this->hubs_.end();
+    this->hubs_[hub_id] = std::move(announcement);
+    return added;
+  }
+
+  /** Forget hubs that did not announce themselves within the expire time, returns their ids */
+  std::vector<std::string> expire_hubs(uint32_t now) {
+    std::vector<std::string> expired;
+    for (auto it = this->hubs_.begin(); it != this->hubs_.end();) {
+      if (now - it->second.received > this->expire_time_ms_) {
+        expired.push_back(it->first);
+        it = this->hubs_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    return expired;
+  }
+
+  /** Recalculate the own claims, returns true when they changed */
+  bool update() {
+    std::set<int> claims;
+    for (auto &reach : this->own_reach_) {
+      if (this->owner_of_(reach.first, reach.second) == this->hub_id_) {
+        claims.insert(reach.first);
+      }
+    }
+
+    if (claims == this->own_claims_) {
+      return false;
+    }
+    this->own_claims_ = std::move(claims);
+    return true;
+  }
+
+  /** Mesh id is claimed by this hub or not claimed by any other hub */
+  bool owns(int mesh_id) const {
+    if (this->own_claims_.count(mesh_id)) {
+      return true;
+    }
+
+    for (auto &hub : this->hubs_) {
+      if (hub.second.claims.count(mesh_id)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+};
+
+}  // namespace awox_mesh
+}  // namespace esphome
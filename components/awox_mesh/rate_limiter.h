@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace awox_mesh {
+
+/**
+ * Token bucket that allows `rate` units per second with a maximal burst of 1 second.
+ *
+ * A rate of 0 disables the limit.
+ */
+class RateLimiter {
+  uint32_t rate_ = 0;
+  /** Tokens in thousandths, so short loop intervals still add up to whole tokens */
+  uint64_t milli_tokens_ = 0;
+  uint32_t last_refill_ = 0;
+
+  uint64_t capacity() const { return (uint64_t) this->rate_ * 1000; }
+
+  void refill(uint32_t now) {
+    const uint32_t elapsed = now - this->last_refill_;
+    if (elapsed == 0) {
+      return;
+    }
+    this->last_refill_ = now;
+
+    const uint64_t milli_tokens = this->milli_tokens_ + (uint64_t) this->rate_ * elapsed;
+    this->milli_tokens_ = milli_tokens > this->capacity() ? this->capacity() : milli_tokens;
+  }
+
+ public:
+  void set_rate(uint32_t rate) {
+    this->rate_ = rate;
+    this->milli_tokens_ = this->capacity();
+  }
+
+  uint32_t get_rate() const { return this->rate_; }
+
+  /** Amounts bigger than the rate are allowed once the bucket is full */
+  bool available(uint32_t amount, uint32_t now) {
+    if (this->rate_ == 0) {
+      return true;
+    }
+    this->refill(now);
+
+    return this->milli_tokens_ >= (uint64_t) amount * 1000 || this->milli_tokens_ == this->capacity();
+  }
+
+  void consume(uint32_t amount) {
+    const uint64_t milli_tokens = (uint64_t) amount * 1000;
+    this->milli_tokens_ = milli_tokens > this->milli_tokens_ ? 0 : this->milli_tokens_ - milli_tokens;
+  }
+
+  bool try_consume(uint32_t amount, uint32_t now) {
+    if (!this->available(amount, now)) {
+      return false;
+    }
+    this->consume(amount);
+    return true;
+  }
+};
+
+}  // namespace awox_mesh
+}  // namespace esphome
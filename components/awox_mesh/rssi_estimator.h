@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace awox_mesh {
+
+/** Weight of a new sample in the moving average and variance */
+#define RSSI_ESTIMATOR_ALPHA 0.25f
+/** Below this number of samples the estimate is penalized */
+#define RSSI_ESTIMATOR_MIN_SAMPLES 5
+/** Penalty in dB for each sample short of RSSI_ESTIMATOR_MIN_SAMPLES */
+#define RSSI_ESTIMATOR_SAMPLE_PENALTY 2
+
+/**
+ * Exponentially weighted moving average and variance of the RSSI of advertisements.
+ *
+ * Single advertisements vary by several dB because of multipath, ranking devices on the last sample makes the hub
+ * connect to a device that only looked strong for a moment.
+ */
+class RssiEstimator {
+  float mean_ = 0;
+  float variance_ = 0;
+  uint16_t samples_ = 0;
+
+ public:
+  void add(int rssi) {
+    if (this->samples_ == 0) {
+      this->mean_ = rssi;
+      this->variance_ = 0;
+    } else {
+      const float diff = rssi - this->mean_;
+      const float increment = RSSI_ESTIMATOR_ALPHA * diff;
+      this->mean_ += increment;
+      this->variance_ = (1 - RSSI_ESTIMATOR_ALPHA) * (this->variance_ + diff * increment);
+    }
+    if (this->samples_ < UINT16_MAX) {
+      this->samples_++;
+    }
+  }
+
+  void reset() {
+    this->mean_ = 0;
+    this->variance_ = 0;
+    this->samples_ = 0;
+  }
+
+  float mean() const { return this->mean_; }
+
+  float stddev() const { return sqrtf(this->variance_); }
+
+  uint16_t samples() const { return this->samples_; }
+
+  /** Mean lowered by the standard deviation and by a penalty when only a few samples are known */
+  int confident_rssi() const {
+    float rssi = this->mean_ - this->stddev();
+    if (this->samples_ < RSSI_ESTIMATOR_MIN_SAMPLES) {
+      rssi -= (RSSI_ESTIMATOR_MIN_SAMPLES - this->samples_) * RSSI_ESTIMATOR_SAMPLE_PENALTY;
+    }
+    return lroundf(rssi);
+  }
+};
+
+}  // namespace awox_mesh
+}  // namespace esphome
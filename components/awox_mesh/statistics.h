@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace awox_mesh {
+
+/**
+ * Counters published on the `<prefix>/statistics` topic.
+ *
+ * Only plain integer members, the struct is compared with memcmp to detect changes.
+ */
+struct MeshStatistics {
+  /** Number of state publications requested (device reports, commands and group aggregates) */
+  uint32_t state_publish_requests = 0;
+  /** Number of state messages actually sent to the broker */
+  uint32_t state_publish_sent = 0;
+  /** Time from boot until the startup gate allowed the first connection attempt */
+  uint32_t boot_to_first_attempt_ms = 0;
+  /** Time from boot until the first connection was ready to send mesh commands */
+  uint32_t boot_to_ready_ms = 0;
+  /** Internal heap taken by the most expensive established connection */
+  uint32_t connection_heap_cost = 0;
+  /** 1 while scanning with a low duty cycle because all advertising devices are linked */
+  uint32_t low_duty_scan = 0;
+  uint32_t scan_mode_changes = 0;
+  /** Smoothed time between a written command and the first notification, per scan mode */
+  uint32_t command_latency_full_scan_ms = 0;
+  uint32_t command_latency_low_duty_scan_ms = 0;
+  /** Online/offline changes of all devices that reverted within the debounce time */
+  uint32_t availability_flaps = 0;
+  /** Status requests sent to devices that were silent too long, and devices marked offline as they didn't answer */
+  uint32_t liveness_probes = 0;
+  uint32_t liveness_offline = 0;
+};
+
+}  // namespace awox_mesh
+}  // namespace esphome
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace awox_mesh {
+
+/** Maximal number of groups stored per device, a group report contains up to 10 groups */
+#define TOPOLOGY_CACHE_GROUPS 8
+#define TOPOLOGY_CACHE_CHUNK_ENTRIES 16
+/** Chunks of entries, each stored as a separate preference (max 128 devices) */
+#define TOPOLOGY_CACHE_CHUNKS 8
+/** Entries restored more often than this without being confirmed by the mesh are refreshed on first contact */
+#define TOPOLOGY_CACHE_MAX_AGE 10
+#define TOPOLOGY_CACHE_NO_GROUP 0xFF
+
+/**
+ * What is learned about a mesh device through its address and group reports, plus the number of mesh devices
+ * reachable when connected to it.
+ */
+struct TopologyEntry {
+  /** 0 marks an unused entry */
+  uint16_t mesh_id;
+  /** Last 4 bytes of the mac address, the first 2 bytes are always A4:C1 */
+  uint8_t mac[4];
+  uint8_t product_id;
+  uint8_t groups[TOPOLOGY_CACHE_GROUPS];
+  uint8_t reach;
+  /** Number of boots since the entry was confirmed by an address report */
+  uint8_t age;
+};
+
+struct TopologyChunk {
+  TopologyEntry entries[TOPOLOGY_CACHE_CHUNK_ENTRIES];
+};
+
+}  // namespace awox_mesh
+}  // namespace esphome
@@ -0,0 +1,54 @@
+#include <cassert>
+#include <cstdio>
+
+#include "advertisement.h"
+
+using namespace esphome::awox_mesh;
+
+// Manufacturer data (after the company id) in the Telink advertisement layout of an AwoX light with mac
+// A4:C1:38:12:34:56, product uuid 0x1300 (product id 0x13), status 0x01 and mesh id 0x0105
+static const uint8_t MAC[6] = {0xA4, 0xC1, 0x38, 0x12, 0x34, 0x56};
+static const std::vector<uint8_t> DATA = {0x11, 0x02, 0x56, 0x34, 0x12, 0x38, 0x00, 0x13,
+                                          0x01, 0x05, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+int main() {
+  AdvertisementInfo info{};
+  assert(decode_advertisement(MAC, DATA, info));
+  assert(info.mesh_id == 0x0105);
+  assert(info.product_uuid == 0x1300);
+  assert(info.product_id == 0x13);
+
+  // Product uuid is little endian, the low byte is not the product id
+  std::vector<uint8_t> data = DATA;
+  data[6] = 0x02;
+  data[7] = 0x21;
+  assert(decode_advertisement(MAC, data, info));
+  assert(info.product_uuid == 0x2102);
+  assert(info.product_id == 0x21);
+
+  // Mesh id above 255
+  data = DATA;
+  data[9] = 0x34;
+  data[10] = 0x12;
+  assert(decode_advertisement(MAC, data, info));
+  assert(info.mesh_id == 0x1234);
+
+  // Advertisement of another device, or another format
+  const uint8_t other_mac[6] = {0xA4, 0xC1, 0x38, 0x12, 0x34, 0x57};
+  AdvertisementInfo untouched{};
+  assert(!decode_advertisement(other_mac, DATA, untouched));
+  assert(untouched.mesh_id == 0);
+
+  // Too short
+  data = std::vector<uint8_t>(DATA.begin(), DATA.begin() + ADVERTISEMENT_MIN_SIZE - 1);
+  assert(!decode_advertisement(MAC, data, untouched));
+
+  // Not part of a mesh yet
+  data = DATA;
+  data[9] = 0;
+  data[10] = 0;
+  assert(!decode_advertisement(MAC, data, untouched));
+
+  printf("test_advertisement: ok\n");
+  return 0;
+}
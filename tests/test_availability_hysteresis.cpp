@@ -0,0 +1,88 @@
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+#include "availability_hysteresis.h"
+#include "deadline_queue.h"
+
+using namespace esphome::awox_mesh;
+
+/** Published availability per device, like AwoxMeshMqtt keeps it */
+static std::vector<int> published(4, -1);
+static size_t indexes[] = {0, 1, 2, 3};
+static DeadlineQueue deadlines;
+
+/** Returns false when the availability is the published one, schedules new deadlines like AwoxMesh does */
+static bool observe(AvailabilityTable &table, size_t index, bool online, uint32_t now) {
+  const AvailabilityObservation observation = table.observe(index, online, published[index] == (int) online, now);
+  if (observation == AVAILABILITY_SCHEDULED) {
+    deadlines.push(table.get_deadline(index), DEADLINE_AVAILABILITY_PUBLISH, &indexes[index]);
+  }
+  return observation != AVAILABILITY_PUBLISHED;
+}
+
+static std::vector<size_t> expire(AvailabilityTable &table, uint32_t now, const std::vector<bool> &online) {
+  std::vector<size_t> expired;
+  while (deadlines.expired(now)) {
+    Deadline deadline = deadlines.pop();
+    const size_t index = *static_cast<size_t *>(deadline.target);
+    if (table.expire(index, deadline.at)) {
+      published[index] = online[index];
+      expired.push_back(index);
+    }
+  }
+  return expired;
+}
+
+int main() {
+  AvailabilityTable table;
+  table.set_online_debounce(1000);
+  table.set_offline_debounce(5000);
+
+  // Online is published after the online debounce time
+  assert(observe(table, 0, true, 0));
+  assert(expire(table, 999, {true}).empty());
+  assert(expire(table, 1000, {true}) == std::vector<size_t>{0});
+  assert(published[0] == 1);
+
+  // Flapping offline and back within the offline debounce time publishes nothing
+  for (uint32_t now = 2000; now < 12000; now += 2000) {
+    assert(observe(table, 0, false, now));
+    assert(!observe(table, 0, true, now + 1000));
+    assert(expire(table, now + 1999, {true}).empty());
+  }
+  assert(table.get_flaps(0) == 5);
+  assert(table.get_flaps() == 5);
+  // Deadlines of the flaps are skipped when they pop
+  assert(expire(table, 19000, {true}).empty());
+  assert(deadlines.size() == 0);
+
+  // Offline is published after the offline debounce time, the deadline doesn't move on repeated reports
+  assert(observe(table, 0, false, 20000));
+  assert(observe(table, 0, false, 24000));
+  assert(deadlines.size() == 1);
+  assert(expire(table, 25000, {false}) == std::vector<size_t>{0});
+  assert(published[0] == 0);
+
+  // Availability published elsewhere (discovery, republish, takeover) is not taken for the published value
+  assert(observe(table, 1, true, 30000));
+  assert(expire(table, 31000, {true, true}) == std::vector<size_t>{1});
+  published[1] = 0;
+  assert(observe(table, 1, true, 40000));
+  assert(expire(table, 41000, {true, true}) == std::vector<size_t>{1});
+  assert(published[1] == 1);
+  assert(table.get_flaps(1) == 0);
+
+  // Cancelled without counting flaps, deadlines are compared across the millis() wrap
+  assert(observe(table, 2, true, UINT32_MAX - 500));
+  table.cancel_pending();
+  deadlines.remove(DEADLINE_AVAILABILITY_PUBLISH);
+  assert(expire(table, 1000, {false, true, true}).empty());
+  assert(observe(table, 2, true, UINT32_MAX - 500));
+  assert(expire(table, 200, {false, true, true}).empty());
+  assert(expire(table, 500, {false, true, true}) == std::vector<size_t>{2});
+  assert(table.get_flaps(2) == 0);
+
+  printf("test_availability_hysteresis: ok\n");
+  return 0;
+}
@@ -0,0 +1,162 @@
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "light_command.h"
+
+using namespace esphome::awox_mesh;
+
+/** Mesh destination without groups or publishing, only the light state is used by the planner */
+class TestDestination : public MeshDestination {
+ public:
+  int dest() override { return 0x8001; }
+  const char *type() const override { return "group"; }
+  bool can_publish_state() override { return false; }
+  std::vector<Group *> get_groups() const override { return {}; }
+  std::string state_as_string() override { return ""; }
+};
+
+static std::vector<uint8_t> ops(const MeshCommandPlan &plan) {
+  std::vector<uint8_t> ops;
+  for (uint8_t i = 0; i < plan.size; i++) {
+    assert(plan.commands[i].dest == 0x8001);
+    ops.push_back(plan.commands[i].op);
+  }
+  return ops;
+}
+
+static std::vector<uint8_t> plan(const LightCommand &command, TestDestination *destination) {
+  MeshCommandPlan plan{};
+  plan_light_command(command, destination, &plan);
+  return ops(plan);
+}
+
+int main() {
+  // Presence bits only report the fields that are set
+  LightCommand command{};
+  assert(!command.has(LIGHT_COMMAND_STATE));
+  command.present |= LIGHT_COMMAND_BRIGHTNESS | LIGHT_COMMAND_EFFECT;
+  assert(command.has(LIGHT_COMMAND_BRIGHTNESS));
+  assert(command.has(LIGHT_COMMAND_EFFECT));
+  assert(!command.has(LIGHT_COMMAND_COLOR));
+  assert(!command.has(LIGHT_COMMAND_STATE));
+
+  // Nothing present plans nothing, even with values set
+  {
+    TestDestination destination;
+    LightCommand empty{};
+    empty.brightness = 255;
+    empty.state = LIGHT_STATE_OFF;
+    assert(plan(empty, &destination).empty());
+  }
+
+  // Color loop settings, mode, brightness, effect, power, regardless of the field order of the payload
+  {
+    TestDestination destination;
+    LightCommand full{};
+    full.present = LIGHT_COMMAND_STATE | LIGHT_COMMAND_BRIGHTNESS | LIGHT_COMMAND_COLOR | LIGHT_COMMAND_EFFECT |
+                   LIGHT_COMMAND_FADE_DURATION | LIGHT_COMMAND_COLOR_DURATION;
+    full.state = LIGHT_STATE_OFF;
+    full.effect = LIGHT_EFFECT_COLOR_LOOP;
+    full.red = 10;
+    full.green = 20;
+    full.blue = 30;
+    full.brightness = 255;
+    full.fade_duration = 2;
+    full.color_duration = 3;
+
+    MeshCommandPlan full_plan{};
+    plan_light_command(full, &destination, &full_plan);
+    assert(ops(full_plan) == (std::vector<uint8_t>{MESH_COMMAND_SEQUENCE_FADE_DURATION,
+                                                   MESH_COMMAND_SEQUENCE_COLOR_DURATION, MESH_COMMAND_COLOR,
+                                                   MESH_COMMAND_COLOR_BRIGHTNESS, MESH_COMMAND_SEQUENCE,
+                                                   MESH_COMMAND_POWER}));
+    assert(full_plan.commands[2].value[0] == 10 && full_plan.commands[2].value[1] == 20);
+    assert(full_plan.commands[2].value[2] == 30);
+    assert(full_plan.commands[3].value[0] == 0x64);
+    assert(full_plan.commands[5].value[0] == 0);
+    assert(!destination.state);
+    assert(destination.color_mode && destination.sequence_mode);
+  }
+
+  // White temperature is the mode for a white brightness
+  {
+    TestDestination destination;
+    destination.color_mode = true;
+    LightCommand white{};
+    white.present = LIGHT_COMMAND_BRIGHTNESS | LIGHT_COMMAND_COLOR_TEMP;
+    white.brightness = 0;
+    white.color_temp = 370;
+    assert(plan(white, &destination) ==
+           (std::vector<uint8_t>{MESH_COMMAND_WHITE_TEMPERATURE, MESH_COMMAND_WHITE_BRIGHTNESS}));
+    assert(!destination.color_mode);
+    assert(destination.temperature == 0x7f);
+    assert(destination.white_brightness == 1);
+  }
+
+  // Power on is left out when another command already turns the light on
+  {
+    TestDestination destination;
+    LightCommand on{};
+    on.present = LIGHT_COMMAND_STATE | LIGHT_COMMAND_BRIGHTNESS;
+    on.state = LIGHT_STATE_ON;
+    on.brightness = 128;
+    assert(plan(on, &destination) == (std::vector<uint8_t>{MESH_COMMAND_WHITE_BRIGHTNESS}));
+    assert(destination.state);
+
+    on.present = LIGHT_COMMAND_STATE;
+    destination.state = false;
+    MeshCommandPlan on_plan{};
+    plan_light_command(on, &destination, &on_plan);
+    assert(ops(on_plan) == (std::vector<uint8_t>{MESH_COMMAND_POWER}));
+    assert(on_plan.commands[0].value[0] == 1);
+    assert(destination.state);
+  }
+
+  // Toggle flips the optimistic state
+  {
+    TestDestination destination;
+    destination.state = true;
+    LightCommand toggle{};
+    toggle.present = LIGHT_COMMAND_STATE;
+    toggle.state = LIGHT_STATE_TOGGLE;
+    MeshCommandPlan toggle_plan{};
+    plan_light_command(toggle, &destination, &toggle_plan);
+    assert(toggle_plan.size == 1 && toggle_plan.commands[0].value[0] == 0);
+    assert(!destination.state);
+  }
+
+  // Stopping an effect on a color light sets the color again, which dedups with a color of the same command
+  {
+    TestDestination destination;
+    LightCommand stop{};
+    stop.present = LIGHT_COMMAND_COLOR | LIGHT_COMMAND_EFFECT;
+    stop.effect = LIGHT_EFFECT_STOP;
+    stop.red = 1;
+    stop.green = 2;
+    stop.blue = 3;
+    assert(plan(stop, &destination) == (std::vector<uint8_t>{MESH_COMMAND_COLOR}));
+  }
+
+  // The same operation twice keeps the position of the first with the last value
+  MeshCommandPlan dedup{};
+  dedup.add(0x8001, MESH_COMMAND_COLOR, 1, 2, 3);
+  dedup.add(0x8001, MESH_COMMAND_POWER, 1);
+  dedup.add(0x8001, MESH_COMMAND_COLOR, 4, 5, 6);
+  assert(ops(dedup) == (std::vector<uint8_t>{MESH_COMMAND_COLOR, MESH_COMMAND_POWER}));
+  assert(dedup.commands[0].value[0] == 4 && dedup.commands[0].value[1] == 5 && dedup.commands[0].value[2] == 6);
+
+  // A full plan drops new operations but still updates the ones it holds
+  MeshCommandPlan full{};
+  for (uint8_t op = 1; op <= MESH_COMMAND_PLAN_MAX_SIZE; op++) {
+    full.add(0x8001, op);
+  }
+  full.add(0x8001, MESH_COMMAND_PLAN_MAX_SIZE + 1);
+  assert(full.size == MESH_COMMAND_PLAN_MAX_SIZE);
+  full.add(0x8001, MESH_COMMAND_POWER, 1);
+  assert(full.size == MESH_COMMAND_PLAN_MAX_SIZE && full.commands[0].value[0] == 1);
+
+  printf("test_light_command: ok\n");
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+#include "mesh_partition.h"
+
+using namespace esphome::awox_mesh;
+
+/** Hub sharing the mesh, announcements are delivered directly instead of through MQTT */
+struct SimulatedHub {
+  MeshPartition partition;
+  bool announcing = true;
+
+  SimulatedHub(const std::string &hub_id, std::map<int, int> reach) {
+    this->partition.set_hub_id(hub_id);
+    this->partition.set_expire_time(60000);
+    this->partition.set_own_reach(std::move(reach));
+  }
+
+  HubAnnouncement announcement(uint32_t now) const {
+    HubAnnouncement announcement{};
+    announcement.reach = this->partition.get_own_reach();
+    announcement.claims = this->partition.get_own_claims();
+    announcement.received = now;
+    return announcement;
+  }
+};
+
+/** Exchange announcements and update the claims until no hub changes them anymore */
+static void settle(std::vector<SimulatedHub *> hubs, uint32_t now) {
+  for (int round = 0; round < 10; round++) {
+    for (auto *from : hubs) {
+      if (!from->announcing) {
+        continue;
+      }
+      for (auto *to : hubs) {
+        to->partition.process_announcement(from->partition.get_hub_id(), from->announcement(now));
+      }
+    }
+
+    bool changed = false;
+    for (auto *hub : hubs) {
+      hub->partition.expire_hubs(now);
+      changed |= hub->partition.update();
+    }
+    if (!changed) {
+      return;
+    }
+  }
+  assert(false && "claims did not settle");
+}
+
+/** Exactly one hub owns the mesh id, and all hubs agree on it */
+static const SimulatedHub *owner(std::vector<SimulatedHub *> hubs, int mesh_id) {
+  const SimulatedHub *owner = nullptr;
+  for (auto *hub : hubs) {
+    if (hub->partition.get_own_claims().count(mesh_id)) {
+      assert(owner == nullptr);
+      owner = hub;
+    }
+  }
+  assert(owner != nullptr);
+  for (auto *hub : hubs) {
+    assert(hub->partition.owns(mesh_id) == (hub == owner));
+  }
+  return owner;
+}
+
+int main() {
+  // Best RSSI wins, equal RSSI goes to the lowest hub id, mesh-only reach loses from a received advertisement
+  SimulatedHub a("hub-a", {{1, -60}, {2, -80}, {3, -65}, {4, PARTITION_RSSI_UNKNOWN}});
+  SimulatedHub b("hub-b", {{1, -70}, {2, -50}, {3, -65}, {4, -90}});
+  SimulatedHub c("hub-c", {{2, -75}, {5, -70}});
+  std::vector<SimulatedHub *> hubs = {&a, &b, &c};
+  settle(hubs, 1000);
+  assert(owner(hubs, 1) == &a);
+  assert(owner(hubs, 2) == &b);
+  assert(owner(hubs, 3) == &a);
+  assert(owner(hubs, 4) == &b);
+  assert(owner(hubs, 5) == &c);
+  assert(a.partition.get_hub_count() == 3);
+
+  // A mesh id no hub claims is owned by everyone, so it isn't lost
+  assert(a.partition.owns(99) && b.partition.owns(99));
+
+  // The claiming hub keeps the mesh id until another hub receives it more than 6 dB stronger
+  b.partition.set_own_reach({{1, -54}, {2, -50}, {3, -65}, {4, -90}});
+  settle(hubs, 2000);
+  assert(owner(hubs, 1) == &a);
+  b.partition.set_own_reach({{1, -53}, {2, -50}, {3, -65}, {4, -90}});
+  settle(hubs, 3000);
+  assert(owner(hubs, 1) == &b);
+
+  // And it doesn't flap back when the RSSI of the previous owner is only a little better
+  a.partition.set_own_reach({{1, -50}, {2, -80}, {3, -65}, {4, PARTITION_RSSI_UNKNOWN}});
+  settle(hubs, 4000);
+  assert(owner(hubs, 1) == &b);
+
+  // Two hubs that started without seeing each other both claim everything, they settle on the best one
+  SimulatedHub d("hub-d", {{7, -70}, {8, -60}});
+  SimulatedHub e("hub-e", {{7, -60}, {8, -60}});
+  settle({&d}, 1000);
+  settle({&e}, 1000);
+  assert(d.partition.get_own_claims().count(7) && e.partition.get_own_claims().count(7));
+  std::vector<SimulatedHub *> late = {&d, &e};
+  settle(late, 2000);
+  assert(owner(late, 7) == &e);
+  assert(owner(late, 8) == &d);
+
+  // Claims of a hub that stopped announcing are released after the expire time
+  c.announcing = false;
+  settle(hubs, 60000);
+  assert(owner(hubs, 5) == &c);
+  assert(!a.partition.owns(5));
+  settle(hubs, 70000);
+  assert(a.partition.get_hub_count() == 2);
+  assert(a.partition.owns(5) && b.partition.owns(5));
+  assert(owner(hubs, 2) == &b);
+
+  printf("test_mesh_partition: ok\n");
+  return 0;
+}
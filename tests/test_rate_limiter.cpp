@@ -0,0 +1,49 @@
+#include <cassert>
+#include <cstdio>
+
+#include "rate_limiter.h"
+
+using esphome::awox_mesh::RateLimiter;
+
+/** Units delivered in `duration` ms when `amount` is requested every `cadence` ms, like the ESPHome loop does */
+static unsigned deliver(uint32_t rate, uint32_t amount, uint32_t cadence, uint32_t duration, uint32_t start = 1000) {
+  RateLimiter limiter;
+  limiter.set_rate(rate);
+
+  unsigned delivered = 0;
+  for (uint32_t now = start; now - start < duration; now += cadence) {
+    while (limiter.try_consume(amount, now)) {
+      delivered += amount;
+    }
+  }
+  return delivered;
+}
+
+int main() {
+  // Initial burst of 1 second plus the rate for 10 seconds, at the ~16 ms cadence of the loop
+  unsigned delivered = deliver(5, 1, 16, 10000);
+  assert(delivered >= 54 && delivered <= 55);
+
+  // Republish of Home Assistant availability and state, 2 messages at a time
+  delivered = deliver(20, 2, 16, 10000);
+  assert(delivered >= 218 && delivered <= 220);
+
+  // Bytes of discovery messages
+  delivered = deliver(4096, 1000, 16, 10000);
+  assert(delivered >= 44000 && delivered <= 45000);
+
+  // Loop faster than 1 ms per token
+  delivered = deliver(5, 1, 1, 10000);
+  assert(delivered >= 54 && delivered <= 55);
+
+  // millis() wraps during the test
+  delivered = deliver(5, 1, 16, 10000, UINT32_MAX - 5000);
+  assert(delivered >= 54 && delivered <= 55);
+
+  // Rate 0 is not limited
+  RateLimiter unlimited;
+  assert(unlimited.try_consume(1000000, 0));
+
+  printf("test_rate_limiter: ok\n");
+  return 0;
+}
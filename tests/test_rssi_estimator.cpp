@@ -0,0 +1,53 @@
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+
+#include "rssi_estimator.h"
+
+using esphome::awox_mesh::RssiEstimator;
+
+static bool near(float a, float b) { return fabsf(a - b) < 0.001f; }
+
+static RssiEstimator feed(const int *trace, size_t size) {
+  RssiEstimator estimator;
+  for (size_t i = 0; i < size; i++) {
+    estimator.add(trace[i]);
+  }
+  return estimator;
+}
+
+int main() {
+  // Mean and variance of the exponentially weighted moving average with alpha 0.25
+  const int known[] = {-70, -74, -66};
+  RssiEstimator estimator = feed(known, 1);
+  assert(near(estimator.mean(), -70) && near(estimator.stddev(), 0));
+  estimator = feed(known, 2);
+  assert(near(estimator.mean(), -71) && near(estimator.stddev() * estimator.stddev(), 3));
+  estimator = feed(known, 3);
+  assert(near(estimator.mean(), -69.75f) && near(estimator.stddev() * estimator.stddev(), 6.9375f));
+  assert(estimator.samples() == 3);
+
+  // Penalty of 2 dB for each sample short of 5
+  assert(estimator.confident_rssi() == (int) lroundf(-69.75f - sqrtf(6.9375f) - 4));
+
+  // A device with a single strong advertisement must not outrank a device that is stable at a better average
+  const int stable[] = {-75, -76, -75, -74, -75, -75, -76, -75, -74, -75};
+  const int spike_last[] = {-80, -81, -80, -79, -80, -80, -81, -80, -79, -60};
+  const int spike_middle[] = {-80, -81, -80, -79, -60, -80, -81, -80, -79, -80};
+  const int stable_rssi = feed(stable, 10).confident_rssi();
+  assert(feed(spike_last, 10).confident_rssi() < stable_rssi);
+  assert(feed(spike_middle, 10).confident_rssi() < stable_rssi);
+
+  // The last sample alone would have ranked the spiky device first
+  assert(spike_last[9] > stable[9]);
+
+  // A single advertisement is not trusted over a device with a stable history
+  const int single[] = {-72};
+  assert(feed(single, 1).confident_rssi() < stable_rssi);
+
+  estimator.reset();
+  assert(estimator.samples() == 0 && near(estimator.mean(), 0));
+
+  printf("test_rssi_estimator: ok\n");
+  return 0;
+}